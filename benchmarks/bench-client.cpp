@@ -0,0 +1,627 @@
+/* A synthetic Wayland client for the benchmarks.
+ *
+ * It opens a number of xdg-shell toplevels backed by wl_shm buffers and
+ * redraws them on every frame callback, damaging them in a scripted pattern.
+ * Optionally each toplevel gets subsurfaces and a popup, which is re-created
+ * periodically, so that subsurface commits and popup map/unmap are exercised
+ * too. The client exits when the compositor goes away. */
+
+#include <wayland-client.h>
+#include "xdg-shell-client-protocol.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+enum damage_pattern_t
+{
+    /* Draw once, never damage again */
+    PATTERN_STATIC,
+    /* Move a small square, damaging only its old and new position */
+    PATTERN_PARTIAL,
+    /* Scroll the contents, damaging the whole surface */
+    PATTERN_SCROLL,
+    /* Change the whole surface */
+    PATTERN_FULL,
+};
+
+struct options_t
+{
+    int windows = 4;
+    int width = 400, height = 300;
+    damage_pattern_t pattern = PATTERN_PARTIAL;
+    int subsurfaces = 0;
+    bool popups = false;
+    bool translucent = false;
+} options;
+
+struct globals_t
+{
+    wl_display *display = nullptr;
+    wl_compositor *compositor = nullptr;
+    wl_subcompositor *subcompositor = nullptr;
+    wl_shm *shm = nullptr;
+    xdg_wm_base *wm_base = nullptr;
+} globals;
+
+/* How often popups are destroyed and re-created, in frames of the parent */
+static constexpr int popup_lifetime = 120;
+static constexpr int square_size = 64;
+static constexpr int scroll_speed = 4;
+
+struct buffer_t
+{
+    wl_buffer *buffer = nullptr;
+    uint32_t *data = nullptr;
+    size_t size = 0;
+    bool busy = false;
+};
+
+static void handle_buffer_release(void *data, wl_buffer*)
+{
+    static_cast<buffer_t*> (data)->busy = false;
+}
+
+static const wl_buffer_listener buffer_listener = {
+    handle_buffer_release,
+};
+
+static bool create_buffer(buffer_t& buf, int width, int height)
+{
+    int stride = width * 4;
+    buf.size = stride * height;
+
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    std::string path = std::string(runtime_dir ? runtime_dir : "/tmp") +
+        "/wf-bench-client-XXXXXX";
+
+    int fd = mkstemp(&path[0]);
+    if (fd < 0)
+        return false;
+
+    unlink(path.c_str());
+    if (ftruncate(fd, buf.size) < 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, buf.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+
+    auto pool = wl_shm_create_pool(globals.shm, fd, buf.size);
+    buf.buffer = wl_shm_pool_create_buffer(pool, 0, width, height, stride,
+        options.translucent ? WL_SHM_FORMAT_ARGB8888 : WL_SHM_FORMAT_XRGB8888);
+    wl_shm_pool_destroy(pool);
+    close(fd);
+
+    buf.data = static_cast<uint32_t*> (data);
+    wl_buffer_add_listener(buf.buffer, &buffer_listener, &buf);
+    return true;
+}
+
+static void destroy_buffer(buffer_t& buf)
+{
+    if (buf.buffer)
+    {
+        wl_buffer_destroy(buf.buffer);
+        munmap(buf.data, buf.size);
+    }
+
+    buf = buffer_t{};
+}
+
+/* A surface which redraws itself on each frame callback */
+struct animated_surface_t
+{
+    wl_surface *surface = nullptr;
+    int width = 0, height = 0;
+    damage_pattern_t pattern;
+    uint32_t color;
+
+    buffer_t buffers[2];
+    wl_callback *frame_callback = nullptr;
+    int frame = 0;
+    /* The frame whose contents were last committed, -1 if none */
+    int committed_frame = -1;
+    /* Called after each frame, before the commit */
+    void (*on_frame)(animated_surface_t*, void*) = nullptr;
+    void *on_frame_data = nullptr;
+
+    animated_surface_t(damage_pattern_t pattern, uint32_t color)
+    {
+        this->pattern = pattern;
+        this->color = color;
+        surface = wl_compositor_create_surface(globals.compositor);
+    }
+
+    ~animated_surface_t()
+    {
+        if (frame_callback)
+            wl_callback_destroy(frame_callback);
+
+        destroy_buffer(buffers[0]);
+        destroy_buffer(buffers[1]);
+        wl_surface_destroy(surface);
+    }
+
+    void resize(int width, int height)
+    {
+        if (width == this->width && height == this->height)
+            return;
+
+        this->width = width;
+        this->height = height;
+        destroy_buffer(buffers[0]);
+        destroy_buffer(buffers[1]);
+    }
+
+    uint32_t pixel(uint32_t rgb) const
+    {
+        if (!options.translucent)
+            return 0xff000000 | rgb;
+
+        /* Premultiplied, half transparent */
+        uint32_t r = ((rgb >> 16) & 0xff) / 2;
+        uint32_t g = ((rgb >> 8) & 0xff) / 2;
+        uint32_t b = (rgb & 0xff) / 2;
+        return 0x80000000 | (r << 16) | (g << 8) | b;
+    }
+
+    void fill(buffer_t& buf, int x, int y, int w, int h, uint32_t rgb)
+    {
+        int x2 = std::min(x + w, width);
+        int y2 = std::min(y + h, height);
+        x = std::max(x, 0);
+        y = std::max(y, 0);
+
+        uint32_t value = pixel(rgb);
+        for (int j = y; j < y2; j++)
+            std::fill_n(buf.data + j * width + x, std::max(x2 - x, 0), value);
+    }
+
+    int square_x(int frame) const
+    {
+        int range = std::max(width - square_size, 1);
+        int pos = (frame * scroll_speed) % (2 * range);
+        return pos < range ? pos : 2 * range - pos;
+    }
+
+    /* Draw the full contents for the current frame. Both buffers are used
+     * in turn, so the parts which didn't change have to be drawn too. */
+    void draw(buffer_t& buf)
+    {
+        switch (pattern)
+        {
+            case PATTERN_STATIC:
+            case PATTERN_PARTIAL:
+                fill(buf, 0, 0, width, height, color);
+                fill(buf, square_x(frame), (height - square_size) / 2,
+                    square_size, square_size, ~color & 0xffffff);
+                break;
+            case PATTERN_SCROLL:
+                for (int y = 0; y < height; y += 16)
+                {
+                    bool odd = ((y + frame * scroll_speed) / 16) % 2;
+                    int offset = (frame * scroll_speed) % 16;
+                    fill(buf, 0, y - offset, width, 16, odd ? color : color / 2);
+                    fill(buf, 0, y - offset + 16, width, 16, odd ? color / 2 : color);
+                }
+                break;
+            case PATTERN_FULL:
+                fill(buf, 0, 0, width, height, (color + frame * 0x010203) & 0xffffff);
+                break;
+        }
+    }
+
+    void damage()
+    {
+        if (pattern == PATTERN_PARTIAL && committed_frame >= 0)
+        {
+            int y = (height - square_size) / 2;
+            wl_surface_damage_buffer(surface, square_x(committed_frame), y,
+                square_size, square_size);
+            wl_surface_damage_buffer(surface, square_x(frame), y,
+                square_size, square_size);
+        } else
+        {
+            wl_surface_damage_buffer(surface, 0, 0, width, height);
+        }
+    }
+
+    buffer_t *get_free_buffer()
+    {
+        for (auto& buf : buffers)
+        {
+            if (!buf.buffer && !create_buffer(buf, width, height))
+                return nullptr;
+
+            if (!buf.busy)
+                return &buf;
+        }
+
+        return nullptr;
+    }
+
+    static void handle_frame_done(void *data, wl_callback *callback, uint32_t)
+    {
+        auto self = static_cast<animated_surface_t*> (data);
+        wl_callback_destroy(callback);
+        self->frame_callback = nullptr;
+
+        ++self->frame;
+        self->redraw();
+    }
+
+    /* Draw and commit the next frame */
+    void redraw()
+    {
+        if (width <= 0 || height <= 0)
+            return;
+
+        static const wl_callback_listener frame_listener = {
+            handle_frame_done,
+        };
+
+        if (pattern != PATTERN_STATIC || frame == 0)
+        {
+            /* If the compositor still holds both buffers, skip this frame
+             * and try again on the next frame callback */
+            auto buf = get_free_buffer();
+            if (buf)
+            {
+                draw(*buf);
+                buf->busy = true;
+                wl_surface_attach(surface, buf->buffer, 0, 0);
+                damage();
+                committed_frame = frame;
+            }
+
+            frame_callback = wl_surface_frame(surface);
+            wl_callback_add_listener(frame_callback, &frame_listener, this);
+        }
+
+        if (on_frame)
+            on_frame(this, on_frame_data);
+
+        wl_surface_commit(surface);
+    }
+};
+
+struct popup_t
+{
+    std::unique_ptr<animated_surface_t> contents;
+    xdg_surface *shell_surface = nullptr;
+    xdg_popup *popup = nullptr;
+    bool configured = false;
+
+    popup_t(xdg_surface *parent, uint32_t color);
+    ~popup_t()
+    {
+        xdg_popup_destroy(popup);
+        xdg_surface_destroy(shell_surface);
+    }
+};
+
+static void handle_popup_surface_configure(void *data, xdg_surface *surface,
+    uint32_t serial)
+{
+    auto popup = static_cast<popup_t*> (data);
+    xdg_surface_ack_configure(surface, serial);
+    if (!popup->configured)
+    {
+        popup->configured = true;
+        popup->contents->redraw();
+    }
+}
+
+static const xdg_surface_listener popup_surface_listener = {
+    handle_popup_surface_configure,
+};
+
+static void handle_popup_configure(void*, xdg_popup*, int32_t, int32_t,
+    int32_t, int32_t) {}
+static void handle_popup_done(void*, xdg_popup*) {}
+
+static const xdg_popup_listener popup_listener = {
+    handle_popup_configure,
+    handle_popup_done,
+};
+
+popup_t::popup_t(xdg_surface *parent, uint32_t color)
+{
+    int width = std::min(150, options.width);
+    int height = std::min(100, options.height);
+
+    contents = std::make_unique<animated_surface_t> (PATTERN_FULL, color);
+    contents->resize(width, height);
+
+    shell_surface = xdg_wm_base_get_xdg_surface(globals.wm_base,
+        contents->surface);
+    xdg_surface_add_listener(shell_surface, &popup_surface_listener, this);
+
+    auto positioner = xdg_wm_base_create_positioner(globals.wm_base);
+    xdg_positioner_set_size(positioner, width, height);
+    xdg_positioner_set_anchor_rect(positioner, 0, 0,
+        options.width / 2, options.height / 2);
+    xdg_positioner_set_anchor(positioner, XDG_POSITIONER_ANCHOR_BOTTOM_RIGHT);
+    xdg_positioner_set_gravity(positioner, XDG_POSITIONER_GRAVITY_BOTTOM_RIGHT);
+
+    popup = xdg_surface_get_popup(shell_surface, parent, positioner);
+    xdg_popup_add_listener(popup, &popup_listener, this);
+    xdg_positioner_destroy(positioner);
+    wl_surface_commit(contents->surface);
+}
+
+struct subsurface_t
+{
+    std::unique_ptr<animated_surface_t> contents;
+    wl_subsurface *subsurface;
+
+    subsurface_t(wl_surface *parent, int index, uint32_t color)
+    {
+        contents = std::make_unique<animated_surface_t> (PATTERN_FULL, color);
+        contents->resize(square_size, square_size);
+
+        subsurface = wl_subcompositor_get_subsurface(globals.subcompositor,
+            contents->surface, parent);
+        wl_subsurface_set_position(subsurface, 8 + index * (square_size + 8), 8);
+        /* Commit independently of the parent, on its own frame callbacks */
+        wl_subsurface_set_desync(subsurface);
+        contents->redraw();
+    }
+
+    ~subsurface_t()
+    {
+        wl_subsurface_destroy(subsurface);
+    }
+};
+
+struct window_t
+{
+    std::unique_ptr<animated_surface_t> contents;
+    xdg_surface *shell_surface;
+    xdg_toplevel *toplevel;
+    bool configured = false;
+    int index;
+
+    std::vector<std::unique_ptr<subsurface_t>> subsurfaces;
+    std::unique_ptr<popup_t> popup;
+
+    window_t(int index);
+    ~window_t()
+    {
+        popup.reset();
+        subsurfaces.clear();
+        xdg_toplevel_destroy(toplevel);
+        xdg_surface_destroy(shell_surface);
+    }
+
+    uint32_t get_color(int salt) const
+    {
+        return ((index + 1) * 0x3f1a27 + salt * 0x1f3b5d) & 0xffffff;
+    }
+
+    static void handle_frame(animated_surface_t *surface, void *data)
+    {
+        auto self = static_cast<window_t*> (data);
+        if (!options.popups)
+            return;
+
+        /* The first popup is created once the window has been mapped */
+        if (surface->frame % popup_lifetime == 1)
+        {
+            self->popup.reset();
+            self->popup = std::make_unique<popup_t> (self->shell_surface,
+                self->get_color(surface->frame / popup_lifetime));
+        }
+    }
+};
+
+static void handle_surface_configure(void *data, xdg_surface *surface,
+    uint32_t serial)
+{
+    auto window = static_cast<window_t*> (data);
+    xdg_surface_ack_configure(surface, serial);
+    if (window->configured)
+        return;
+
+    window->configured = true;
+    for (int i = 0; i < options.subsurfaces; i++)
+    {
+        window->subsurfaces.push_back(std::make_unique<subsurface_t> (
+                window->contents->surface, i, window->get_color(i + 1)));
+    }
+
+    window->contents->redraw();
+}
+
+static const xdg_surface_listener surface_listener = {
+    handle_surface_configure,
+};
+
+static void handle_toplevel_configure(void *data, xdg_toplevel*,
+    int32_t width, int32_t height, wl_array*)
+{
+    auto window = static_cast<window_t*> (data);
+    if (width > 0 && height > 0)
+        window->contents->resize(width, height);
+}
+
+static void handle_toplevel_close(void*, xdg_toplevel*) {}
+
+static const xdg_toplevel_listener toplevel_listener = {
+    handle_toplevel_configure,
+    handle_toplevel_close,
+};
+
+window_t::window_t(int index)
+{
+    this->index = index;
+    contents = std::make_unique<animated_surface_t> (options.pattern,
+        get_color(0));
+    contents->resize(options.width, options.height);
+    contents->on_frame = handle_frame;
+    contents->on_frame_data = this;
+
+    shell_surface = xdg_wm_base_get_xdg_surface(globals.wm_base,
+        contents->surface);
+    xdg_surface_add_listener(shell_surface, &surface_listener, this);
+
+    toplevel = xdg_surface_get_toplevel(shell_surface);
+    xdg_toplevel_add_listener(toplevel, &toplevel_listener, this);
+    xdg_toplevel_set_title(toplevel, ("wf-bench-client " +
+            std::to_string(index)).c_str());
+    xdg_toplevel_set_app_id(toplevel, "wf-bench-client");
+
+    wl_surface_commit(contents->surface);
+}
+
+static void handle_ping(void*, xdg_wm_base *wm_base, uint32_t serial)
+{
+    xdg_wm_base_pong(wm_base, serial);
+}
+
+static const xdg_wm_base_listener wm_base_listener = {
+    handle_ping,
+};
+
+static void handle_global(void*, wl_registry *registry, uint32_t name,
+    const char *interface, uint32_t version)
+{
+    if (!strcmp(interface, wl_compositor_interface.name))
+    {
+        globals.compositor = (wl_compositor*) wl_registry_bind(registry, name,
+            &wl_compositor_interface, std::min(version, 4u));
+    } else if (!strcmp(interface, wl_subcompositor_interface.name))
+    {
+        globals.subcompositor = (wl_subcompositor*) wl_registry_bind(registry,
+            name, &wl_subcompositor_interface, 1);
+    } else if (!strcmp(interface, wl_shm_interface.name))
+    {
+        globals.shm = (wl_shm*) wl_registry_bind(registry, name,
+            &wl_shm_interface, 1);
+    } else if (!strcmp(interface, xdg_wm_base_interface.name))
+    {
+        globals.wm_base = (xdg_wm_base*) wl_registry_bind(registry, name,
+            &xdg_wm_base_interface, 1);
+        xdg_wm_base_add_listener(globals.wm_base, &wm_base_listener, NULL);
+    }
+}
+
+static void handle_global_remove(void*, wl_registry*, uint32_t) {}
+
+static const wl_registry_listener registry_listener = {
+    handle_global,
+    handle_global_remove,
+};
+
+static void usage(const char *name)
+{
+    std::fprintf(stderr, "usage: %s [--windows N] [--size WxH] "
+        "[--pattern static|partial|scroll|full] [--subsurfaces N] "
+        "[--popups] [--translucent]\n", name);
+}
+
+static bool parse_options(int argc, char *argv[])
+{
+    struct option opts[] = {
+        { "windows",     required_argument, NULL, 'w' },
+        { "size",        required_argument, NULL, 's' },
+        { "pattern",     required_argument, NULL, 'p' },
+        { "subsurfaces", required_argument, NULL, 'S' },
+        { "popups",      no_argument,       NULL, 'P' },
+        { "translucent", no_argument,       NULL, 't' },
+        { 0,             0,                 NULL,  0  }
+    };
+
+    int c, i;
+    while((c = getopt_long(argc, argv, "w:s:p:S:Pt", opts, &i)) != -1)
+    {
+        switch(c)
+        {
+            case 'w':
+                options.windows = std::max(1, atoi(optarg));
+                break;
+            case 's':
+                if (sscanf(optarg, "%dx%d", &options.width, &options.height) != 2 ||
+                    options.width <= 0 || options.height <= 0)
+                {
+                    return false;
+                }
+                break;
+            case 'p':
+                if (!strcmp(optarg, "static"))
+                    options.pattern = PATTERN_STATIC;
+                else if (!strcmp(optarg, "partial"))
+                    options.pattern = PATTERN_PARTIAL;
+                else if (!strcmp(optarg, "scroll"))
+                    options.pattern = PATTERN_SCROLL;
+                else if (!strcmp(optarg, "full"))
+                    options.pattern = PATTERN_FULL;
+                else
+                    return false;
+                break;
+            case 'S':
+                options.subsurfaces = std::max(0, atoi(optarg));
+                break;
+            case 'P':
+                options.popups = true;
+                break;
+            case 't':
+                options.translucent = true;
+                break;
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!parse_options(argc, argv))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    globals.display = wl_display_connect(NULL);
+    if (!globals.display)
+    {
+        std::fprintf(stderr, "failed to connect to the compositor\n");
+        return EXIT_FAILURE;
+    }
+
+    auto registry = wl_display_get_registry(globals.display);
+    wl_registry_add_listener(registry, &registry_listener, NULL);
+    wl_display_roundtrip(globals.display);
+
+    if (!globals.compositor || !globals.subcompositor || !globals.shm ||
+        !globals.wm_base)
+    {
+        std::fprintf(stderr, "the compositor is missing required globals\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::unique_ptr<window_t>> windows;
+    for (int i = 0; i < options.windows; i++)
+        windows.push_back(std::make_unique<window_t> (i));
+
+    /* Run until the compositor exits */
+    while (wl_display_dispatch(globals.display) != -1);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,407 @@
+#include <plugin.hpp>
+#include <output.hpp>
+#include <core.hpp>
+#include <view.hpp>
+#include <debug.hpp>
+#include <util.hpp>
+#include <render-manager.hpp>
+#include <workspace-manager.hpp>
+#include <signal-definitions.hpp>
+#include "core/alloc-stats.hpp"
+
+extern "C"
+{
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+#include <wlr/interfaces/wlr_keyboard.h>
+#include <wlr/types/wlr_input_device.h>
+#include <wlr/types/wlr_pointer.h>
+#include <wlr/types/wlr_output.h>
+}
+
+#include <linux/input-event-codes.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+/* Runs a benchmark scenario on the headless backend and measures the frames
+ * of render_manager paint(): the time from the start of paint() until after
+ * the buffer swap, the damaged area and the number of allocations.
+ *
+ * The scenario starts when the configured number of views has been mapped,
+ * for ex. from the benchmark client started by autostart. Input is simulated
+ * with a headless keyboard and pointer, so the key combinations used here
+ * have to match the bindings in the benchmark's config file. After a warmup
+ * and the measured duration, the results are printed to stdout and the
+ * compositor exits. */
+class wayfire_bench : public wf::plugin_interface_t
+{
+    struct frame_sample_t
+    {
+        int64_t paint_us;
+        double damage;
+        uint64_t allocations;
+    };
+
+    enum bench_state_t
+    {
+        BENCH_WAITING,
+        BENCH_WARMUP,
+        BENCH_MEASURING,
+        BENCH_DONE,
+    };
+
+    std::string scenario;
+    int views_wanted, warmup_ms, duration_ms, timeout_ms;
+
+    bench_state_t state = BENCH_WAITING;
+    bool instance_active = false;
+
+    wf::signal_callback_t view_mapped;
+    wf::wl_idle_call idle_check_start;
+    wf::effect_hook_t pre_hook, overlay_hook, post_hook;
+    wf::wl_timer phase_timer, step_timer;
+
+    timespec paint_start;
+    uint64_t paint_allocations;
+    bool painted;
+    double paint_damage;
+    std::vector<frame_sample_t> samples;
+    timespec measure_start;
+
+    wlr_input_device *keyboard = nullptr, *pointer = nullptr;
+    int step = 0;
+    wf_point drag_center;
+
+    static constexpr int step_interval_ms = 16;
+    static constexpr int switcher_interval_steps = 30;
+    static constexpr int drag_radius = 100;
+
+  public:
+    void init(wayfire_config *config)
+    {
+        grab_interface->name = "bench";
+        grab_interface->capabilities = 0;
+
+        /* The benchmark drives the whole compositor, so it runs only on the
+         * first output */
+        static bool benchmark_started = false;
+        if (benchmark_started)
+            return;
+
+        benchmark_started = true;
+        instance_active = true;
+
+        auto section = config->get_section("bench");
+        scenario = section->get_option("scenario", "idle")->as_string();
+        views_wanted = section->get_option("views", "4")->as_int();
+        warmup_ms = section->get_option("warmup", "2000")->as_int();
+        duration_ms = section->get_option("duration", "10000")->as_int();
+        timeout_ms = section->get_option("timeout", "20000")->as_int();
+
+        pre_hook = [=] () { frame_started(); };
+        overlay_hook = [=] () { frame_rendered(); };
+        post_hook = [=] () { frame_done(); };
+        output->render->add_effect(&pre_hook, wf::OUTPUT_EFFECT_PRE);
+        output->render->add_effect(&overlay_hook, wf::OUTPUT_EFFECT_OVERLAY);
+        output->render->add_effect(&post_hook, wf::OUTPUT_EFFECT_POST);
+
+        /* The view might not be fully mapped while the signal is emitted */
+        view_mapped = [=] (wf::signal_data_t*) {
+            idle_check_start.run_once([=] () { check_start(); });
+        };
+        output->connect_signal("map-view", &view_mapped);
+
+        /* The event loop isn't running yet, and wl_display_run() would
+         * override an earlier wl_display_terminate() */
+        if (!create_input_devices())
+        {
+            phase_timer.set_timeout(1, [=] () { finish(false); });
+            return;
+        }
+
+        phase_timer.set_timeout(timeout_ms, [=] () {
+            log_error("bench: only %d of %d views were mapped in time",
+                count_views(), views_wanted);
+            finish(false);
+        });
+    }
+
+    static void find_headless(wlr_backend *backend, void *data)
+    {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**> (data) = backend;
+    }
+
+    bool create_input_devices()
+    {
+        wlr_backend *headless = nullptr;
+        auto backend = wf::get_core().backend;
+        if (wlr_backend_is_headless(backend))
+            headless = backend;
+        else if (wlr_backend_is_multi(backend))
+            wlr_multi_for_each_backend(backend, find_headless, &headless);
+
+        if (!headless)
+        {
+            log_error("bench: needs the headless backend, "
+                "run with WLR_BACKENDS=headless");
+            return false;
+        }
+
+        keyboard = wlr_headless_add_input_device(headless,
+            WLR_INPUT_DEVICE_KEYBOARD);
+        pointer = wlr_headless_add_input_device(headless,
+            WLR_INPUT_DEVICE_POINTER);
+
+        return keyboard && pointer;
+    }
+
+    int count_views()
+    {
+        int count = 0;
+        for (auto& view : output->workspace->get_views_in_layer(wf::WM_LAYERS))
+            count += view->is_mapped() ? 1 : 0;
+
+        return count;
+    }
+
+    void check_start()
+    {
+        if (state != BENCH_WAITING || count_views() < views_wanted)
+            return;
+
+        state = BENCH_WARMUP;
+        output->disconnect_signal("map-view", &view_mapped);
+        log_info("bench: starting scenario %s", scenario.c_str());
+
+        start_scenario();
+        phase_timer.set_timeout(warmup_ms, [=] () {
+            state = BENCH_MEASURING;
+            samples.clear();
+            clock_gettime(CLOCK_MONOTONIC, &measure_start);
+
+            phase_timer.set_timeout(duration_ms, [=] () { finish(true); });
+        });
+    }
+
+    /* Simulated input */
+    void send_key(uint32_t key, bool pressed)
+    {
+        wlr_event_keyboard_key ev;
+        ev.time_msec = get_current_time();
+        ev.keycode = key;
+        ev.update_state = true;
+        ev.state = pressed ? WLR_KEY_PRESSED : WLR_KEY_RELEASED;
+        wlr_keyboard_notify_key(keyboard->keyboard, &ev);
+    }
+
+    void send_motion(wf_point point)
+    {
+        auto og = output->get_layout_geometry();
+
+        wlr_event_pointer_motion_absolute ev;
+        ev.device = pointer;
+        ev.time_msec = get_current_time();
+        ev.x = 1.0 * (point.x - og.x) / og.width;
+        ev.y = 1.0 * (point.y - og.y) / og.height;
+        wl_signal_emit(&pointer->pointer->events.motion_absolute, &ev);
+        wl_signal_emit(&pointer->pointer->events.frame, pointer->pointer);
+    }
+
+    void send_button(uint32_t button, bool pressed)
+    {
+        wlr_event_pointer_button ev;
+        ev.device = pointer;
+        ev.time_msec = get_current_time();
+        ev.button = button;
+        ev.state = pressed ? WLR_BUTTON_PRESSED : WLR_BUTTON_RELEASED;
+        wl_signal_emit(&pointer->pointer->events.button, &ev);
+        wl_signal_emit(&pointer->pointer->events.frame, pointer->pointer);
+    }
+
+    /* Scenarios */
+    void start_scenario()
+    {
+        auto views = output->workspace->get_views_in_layer(wf::WM_LAYERS);
+        if (scenario == "expo")
+        {
+            /* Give each workspace something to update while zoomed out */
+            auto grid = output->workspace->get_workspace_grid_size();
+            for (size_t i = 0; i < views.size(); i++)
+            {
+                int ws = i % (grid.width * grid.height);
+                output->workspace->move_to_workspace(views[i],
+                    {ws % grid.width, ws / grid.width});
+            }
+
+            /* [expo] toggle = <super> KEY_E */
+            send_key(KEY_LEFTMETA, true);
+            send_key(KEY_E, true);
+            send_key(KEY_E, false);
+            send_key(KEY_LEFTMETA, false);
+        } else if (scenario == "switcher")
+        {
+            /* [switcher] next_view = <alt> KEY_TAB, alt stays pressed so that
+             * the switcher stays open */
+            send_key(KEY_LEFTALT, true);
+        } else if (scenario == "wobbly")
+        {
+            /* [move] activate = <super> BTN_LEFT */
+            auto og = output->get_layout_geometry();
+            drag_center = {og.x + og.width / 2, og.y + og.height / 2};
+            if (!views.empty())
+            {
+                auto wm = views[0]->get_wm_geometry();
+                drag_center = {og.x + wm.x + wm.width / 2,
+                    og.y + wm.y + wm.height / 2};
+            }
+
+            send_motion(drag_center);
+            send_key(KEY_LEFTMETA, true);
+            send_button(BTN_LEFT, true);
+        } else if (scenario != "idle" && scenario != "blur" &&
+            scenario != "scroll" && scenario != "popups")
+        {
+            log_error("bench: unknown scenario %s, running idle",
+                scenario.c_str());
+        }
+
+        step_timer.set_timeout(step_interval_ms, [=] () { scenario_step(); });
+    }
+
+    void scenario_step()
+    {
+        ++step;
+        if (scenario == "switcher" && step % switcher_interval_steps == 0)
+        {
+            send_key(KEY_TAB, true);
+            send_key(KEY_TAB, false);
+        } else if (scenario == "wobbly")
+        {
+            /* Drag the view around in a circle */
+            double angle = step * 0.1;
+            send_motion({drag_center.x + int(drag_radius * std::cos(angle)) - drag_radius,
+                drag_center.y + int(drag_radius * std::sin(angle))});
+        }
+
+        if (state != BENCH_DONE)
+            step_timer.set_timeout(step_interval_ms, [=] () { scenario_step(); });
+    }
+
+    /* Measurement */
+    void frame_started()
+    {
+        clock_gettime(CLOCK_MONOTONIC, &paint_start);
+        paint_allocations = wf::alloc_stats::get_count();
+        painted = false;
+    }
+
+    void frame_rendered()
+    {
+        int width, height;
+        wlr_output_transformed_resolution(output->handle, &width, &height);
+
+        wf_region damage = output->render->get_scheduled_damage();
+        damage &= wlr_box{0, 0, width, height};
+
+        int64_t pixels = 0;
+        for (const auto& box : damage)
+            pixels += int64_t(box.x2 - box.x1) * (box.y2 - box.y1);
+
+        painted = true;
+        paint_damage = 1.0 * pixels / std::max(int64_t(width) * height, int64_t(1));
+    }
+
+    static int64_t elapsed_us(const timespec& start)
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return (now.tv_sec - start.tv_sec) * 1000000ll +
+            (now.tv_nsec - start.tv_nsec) / 1000ll;
+    }
+
+    void frame_done()
+    {
+        if (state != BENCH_MEASURING || !painted)
+            return;
+
+        samples.push_back({elapsed_us(paint_start), paint_damage,
+            wf::alloc_stats::get_count() - paint_allocations});
+    }
+
+    void finish(bool success)
+    {
+        if (state == BENCH_DONE)
+            return;
+
+        state = BENCH_DONE;
+        phase_timer.disconnect();
+        step_timer.disconnect();
+
+        if (success)
+            print_results();
+
+        /* The runner script checks for the results line */
+        wl_display_terminate(wf::get_core().display);
+    }
+
+    void print_results()
+    {
+        double seconds = elapsed_us(measure_start) / 1e6;
+        int frames = samples.size();
+
+        std::vector<int64_t> paint_times;
+        double total_damage = 0, total_allocations = 0;
+        for (auto& sample : samples)
+        {
+            paint_times.push_back(sample.paint_us);
+            total_damage += sample.damage;
+            total_allocations += sample.allocations;
+        }
+
+        std::sort(paint_times.begin(), paint_times.end());
+        auto percentile = [&] (double p) -> double {
+            if (paint_times.empty())
+                return 0;
+
+            size_t idx = std::min(paint_times.size() - 1,
+                size_t(p * paint_times.size()));
+            return paint_times[idx] / 1000.0;
+        };
+
+        double avg_ms = 0;
+        for (auto t : paint_times)
+            avg_ms += t / 1000.0;
+        avg_ms /= std::max(frames, 1);
+
+        /* Allocations are -1 if the build doesn't count them */
+        double allocations = wf::alloc_stats::is_available() ?
+            total_allocations / std::max(frames, 1) : -1;
+
+        std::printf("wf-bench: scenario=%s frames=%d fps=%.1f "
+            "paint_avg_ms=%.3f paint_p50_ms=%.3f paint_p95_ms=%.3f "
+            "paint_max_ms=%.3f damage_avg_pct=%.1f allocs_per_frame=%.1f\n",
+            scenario.c_str(), frames, frames / std::max(seconds, 1e-3),
+            avg_ms, percentile(0.5), percentile(0.95), percentile(1.0),
+            100.0 * total_damage / std::max(frames, 1), allocations);
+        std::fflush(stdout);
+    }
+
+    void fini()
+    {
+        if (!instance_active)
+            return;
+
+        finish(false);
+        output->render->rem_effect(&pre_hook);
+        output->render->rem_effect(&overlay_hook);
+        output->render->rem_effect(&post_hook);
+        output->disconnect_signal("map-view", &view_mapped);
+    }
+};
+
+DECLARE_WAYFIRE_PLUGIN(wayfire_bench);
@@ -0,0 +1,322 @@
+#include <util.hpp>
+#include <opengl.hpp>
+#include <view-transform.hpp>
+#include <compositor-view.hpp>
+#include "main.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+/* Micro-benchmarks of the region and box helpers used on every repaint.
+ *
+ * Each benchmark is run with regions of 1, 16 and 128 rectangles, which
+ * roughly correspond to a single damaged window, a few damaged windows with
+ * borders and text, and the union of many damaged surfaces. The number of
+ * iterations is increased until a run takes at least --min-time seconds, and
+ * the average time per iteration is printed, in the same way as Google
+ * Benchmark does.
+ *
+ * Usage: wf-region-bench [--min-time <seconds>] [filter] */
+
+/* The benchmarks link against the compositor, which expects main() to
+ * provide the runtime configuration */
+wf_runtime_config runtime_config;
+
+namespace
+{
+const wlr_box output_box = {0, 0, 1920, 1080};
+
+/* Keeps the compiler from optimizing away the result of a benchmark */
+template<class T> void do_not_optimize(T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/* Generate a region with (at least) count rectangles, which don't overlap,
+ * spread over the output */
+wf_region make_region(int count, int seed)
+{
+    std::mt19937 gen(seed);
+    int cols = std::ceil(std::sqrt(count));
+    int rows = (count + cols - 1) / cols;
+    int cell_w = output_box.width / cols;
+    int cell_h = output_box.height / rows;
+
+    wf_region region;
+    for (int i = 0; i < count; i++)
+    {
+        std::uniform_int_distribution<int> w(cell_w / 4, cell_w - 1);
+        std::uniform_int_distribution<int> h(cell_h / 4, cell_h - 1);
+
+        wlr_box box;
+        box.width = w(gen);
+        box.height = h(gen);
+        box.x = (i % cols) * cell_w +
+            std::uniform_int_distribution<int>(0, cell_w - box.width)(gen);
+        box.y = (i / cols) * cell_h +
+            std::uniform_int_distribution<int>(0, cell_h - box.height)(gen);
+
+        region |= box;
+    }
+
+    return region;
+}
+
+struct fixture_t
+{
+    wf_region a, b;
+    wlr_box box = {320, 180, 1280, 720};
+    wf_point delta = {-1920, 1080};
+};
+
+using bench_func_t = std::function<void(fixture_t&, int64_t)>;
+
+struct benchmark_t
+{
+    std::string name;
+    bench_func_t func;
+};
+
+std::vector<benchmark_t> benchmarks;
+
+void add_benchmark(std::string name, bench_func_t func)
+{
+    benchmarks.push_back({name, func});
+}
+
+/* Returns the average time in ns of one iteration */
+double run_benchmark(const benchmark_t& bench, fixture_t& fixture,
+    double min_time, int64_t& iterations)
+{
+    using clock = std::chrono::steady_clock;
+
+    iterations = 1;
+    while (true)
+    {
+        auto start = clock::now();
+        bench.func(fixture, iterations);
+        double elapsed =
+            std::chrono::duration<double>(clock::now() - start).count();
+
+        if (elapsed >= min_time || iterations >= (1ll << 40))
+            return elapsed * 1e9 / iterations;
+
+        /* Aim a bit above min_time, so that usually one more run is enough */
+        double factor = elapsed > 0 ? 1.4 * min_time / elapsed : 10;
+        iterations = iterations * std::max(2.0, std::min(factor, 10.0));
+    }
+}
+
+void register_benchmarks(wayfire_view view)
+{
+    /* Set operations */
+    add_benchmark("union", [] (fixture_t& f, int64_t n) {
+        while (n--)
+        {
+            auto r = f.a | f.b;
+            do_not_optimize(r);
+        }
+    });
+
+    add_benchmark("union_in_place", [] (fixture_t& f, int64_t n) {
+        wf_region r;
+        while (n--)
+        {
+            r = f.a;
+            r |= f.b;
+            do_not_optimize(r);
+        }
+    });
+
+    add_benchmark("intersect_box", [] (fixture_t& f, int64_t n) {
+        while (n--)
+        {
+            auto r = f.a & f.box;
+            do_not_optimize(r);
+        }
+    });
+
+    add_benchmark("intersect_region", [] (fixture_t& f, int64_t n) {
+        while (n--)
+        {
+            auto r = f.a & f.b;
+            do_not_optimize(r);
+        }
+    });
+
+    add_benchmark("subtract", [] (fixture_t& f, int64_t n) {
+        while (n--)
+        {
+            auto r = f.a ^ f.b;
+            do_not_optimize(r);
+        }
+    });
+
+    add_benchmark("translate", [] (fixture_t& f, int64_t n) {
+        while (n--)
+        {
+            auto r = f.a + f.delta;
+            do_not_optimize(r);
+        }
+    });
+
+    add_benchmark("expand_edges", [] (fixture_t& f, int64_t n) {
+        wf_region r;
+        while (n--)
+        {
+            r = f.a;
+            r.expand_edges(-1);
+            do_not_optimize(r);
+        }
+    });
+
+    add_benchmark("scale_integer", [] (fixture_t& f, int64_t n) {
+        while (n--)
+        {
+            auto r = f.a * 2.0f;
+            do_not_optimize(r);
+        }
+    });
+
+    add_benchmark("scale_fractional", [] (fixture_t& f, int64_t n) {
+        while (n--)
+        {
+            auto r = f.a * 1.25f;
+            do_not_optimize(r);
+        }
+    });
+
+    /* Combined patterns from the repaint loop */
+    add_benchmark("translated_intersection_temporaries",
+        [] (fixture_t& f, int64_t n) {
+        wf_region r;
+        while (n--)
+        {
+            r = (f.a & f.box) + f.delta;
+            do_not_optimize(r);
+        }
+    });
+
+    add_benchmark("translated_intersection_in_place",
+        [] (fixture_t& f, int64_t n) {
+        wf_region r;
+        while (n--)
+        {
+            r.set_translated_intersection(f.a, f.box, f.delta);
+            do_not_optimize(r);
+        }
+    });
+
+    /* What subtract_opaque() does when the cached opaque region of a surface
+     * has to be recomputed */
+    add_benchmark("scale_and_subtract", [] (fixture_t& f, int64_t n) {
+        wf_region r, opaque;
+        while (n--)
+        {
+            r = f.a;
+            opaque = f.b + wf_point{10, 10};
+            opaque *= 1.5f;
+            opaque.expand_edges(-1);
+            r ^= opaque;
+            do_not_optimize(r);
+        }
+    });
+
+    /* Coordinate conversions done for each damaged rectangle */
+    auto add_fb_benchmark = [] (std::string name, uint32_t transform) {
+        add_benchmark(name, [=] (fixture_t& f, int64_t n) {
+            wf_framebuffer fb;
+            fb.geometry = output_box;
+            fb.wl_transform = transform;
+            fb.viewport_width = output_box.width;
+            fb.viewport_height = output_box.height;
+            if (transform & 1)
+                std::swap(fb.viewport_width, fb.viewport_height);
+
+            while (n--)
+            {
+                for (const auto& rect : f.a)
+                {
+                    auto box = fb.framebuffer_box_from_damage_box(
+                        wlr_box_from_pixman_box(rect));
+                    do_not_optimize(box);
+                }
+            }
+        });
+    };
+
+    add_fb_benchmark("framebuffer_box_normal", WL_OUTPUT_TRANSFORM_NORMAL);
+    add_fb_benchmark("framebuffer_box_rotated", WL_OUTPUT_TRANSFORM_90);
+
+    /* A transformer as used by the switcher and expo animations */
+    add_benchmark("bounding_box_2D", [=] (fixture_t& f, int64_t n) {
+        wf_2D_view transformer{view};
+        transformer.angle = M_PI / 6;
+        transformer.scale_x = transformer.scale_y = 0.6;
+        transformer.translation_x = 100;
+
+        auto geometry = view->get_wm_geometry();
+        while (n--)
+        {
+            for (const auto& rect : f.a)
+            {
+                auto box = transformer.get_bounding_box(geometry,
+                    wlr_box_from_pixman_box(rect));
+                do_not_optimize(box);
+            }
+        }
+    });
+}
+}
+
+int main(int argc, char *argv[])
+{
+    double min_time = 0.2;
+    std::string filter;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "--min-time") && i + 1 < argc)
+        {
+            min_time = std::atof(argv[++i]);
+        } else
+        {
+            filter = argv[i];
+        }
+    }
+
+    /* Not added to any output, it only provides the geometry for the
+     * transformers */
+    auto view = new wf::color_rect_view_t();
+    view->set_geometry(output_box);
+    register_benchmarks(view->self());
+
+    std::printf("%-48s %14s %12s\n", "Benchmark", "Time", "Iterations");
+    for (int rects : {1, 16, 128})
+    {
+        fixture_t fixture;
+        fixture.a = make_region(rects, 1);
+        fixture.b = make_region(rects, 2);
+
+        for (auto& bench : benchmarks)
+        {
+            auto name = bench.name + "/" + std::to_string(rects);
+            if (name.find(filter) == std::string::npos)
+                continue;
+
+            int64_t iterations;
+            double ns = run_benchmark(bench, fixture, min_time, iterations);
+            std::printf("%-48s %11.1f ns %12lld\n", name.c_str(), ns,
+                (long long)iterations);
+            std::fflush(stdout);
+        }
+    }
+
+    return 0;
+}
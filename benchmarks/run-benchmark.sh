@@ -0,0 +1,77 @@
+#!/bin/sh
+# Runs one benchmark scenario: starts wayfire on the headless backend with
+# software rendering, the benchmark plugin and the synthetic client, and
+# prints the results line of the benchmark plugin.
+#
+# usage: run-benchmark.sh <wayfire> <client> <scenario> <plugin.so>... -- [client args]
+
+set -u
+
+if [ $# -lt 4 ]; then
+    echo "usage: $0 <wayfire> <client> <scenario> <plugin.so>... -- [client args]" >&2
+    exit 1
+fi
+
+wayfire=$1
+client=$2
+scenario=$3
+shift 3
+
+plugins=""
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+    plugins="$plugins $1"
+    shift
+done
+[ $# -gt 0 ] && shift
+
+workdir=$(mktemp -d "${TMPDIR:-/tmp}/wf-bench.XXXXXX") || exit 1
+trap 'rm -rf "$workdir"' EXIT
+
+# wl_display_add_socket_auto() needs a runtime directory
+if [ -z "${XDG_RUNTIME_DIR:-}" ]; then
+    export XDG_RUNTIME_DIR="$workdir"
+fi
+
+cat > "$workdir/wayfire.ini" <<INI
+[core]
+plugins = $plugins
+vwidth = 3
+vheight = 2
+xwayland = 0
+shader_cache = 0
+
+[autostart]
+bench_client = $client $*
+
+[bench]
+scenario = $scenario
+views = ${WF_BENCH_VIEWS:-4}
+warmup = ${WF_BENCH_WARMUP:-2000}
+duration = ${WF_BENCH_DURATION:-10000}
+
+[expo]
+toggle = <super> KEY_E
+
+[switcher]
+next_view = <alt> KEY_TAB
+
+[move]
+activate = <super> BTN_LEFT
+
+[blur]
+mode = normal
+INI
+
+export WLR_BACKENDS=headless
+# llvmpipe, so that the results don't depend on the GPU of the machine
+export LIBGL_ALWAYS_SOFTWARE=1
+unset WAYLAND_DISPLAY DISPLAY
+
+"$wayfire" -c "$workdir/wayfire.ini" > "$workdir/output" 2> "$workdir/log"
+status=$?
+
+if ! grep '^wf-bench:' "$workdir/output"; then
+    echo "benchmark $scenario failed (exit status $status), log:" >&2
+    tail -n 50 "$workdir/log" >&2
+    exit 1
+fi
@@ -126,6 +126,8 @@ class wayfire_animation : public wf::plugin_interface_t
             section->get_option("fire_particles", "2000");
         FireAnimation::fire_particle_size =
             section->get_option("fire_particle_size", "16");
+        FireAnimation::fire_gpu_simulation =
+            section->get_option("fire_gpu_simulation", "0");
 
         output->connect_signal("map-view", &on_view_mapped);
         output->connect_signal("pre-unmap-view", &on_view_unmapped);
@@ -8,6 +8,7 @@
 
 wf_option FireAnimation::fire_particles;
 wf_option FireAnimation::fire_particle_size;
+wf_option FireAnimation::fire_gpu_simulation;
 
 // generate a random float between s and e
 static float random(float s, float e)
@@ -33,7 +34,8 @@ class FireTransformer : public wf_view_transformer_t
 
     FireTransformer(wayfire_view view) :
         ps(FireAnimation::fire_particles->as_cached_int(),
-           [=] (Particle& p) {init_particle(p); })
+           [=] (Particle& p) {init_particle(p); },
+           FireAnimation::fire_gpu_simulation->as_cached_int())
     {
         last_boundingbox = view->get_bounding_box();
         ps.resize(particle_count_for_width(last_boundingbox.width));
@@ -17,7 +17,7 @@ class FireAnimation : public animation_base
 
     public:
 
-    static wf_option fire_particles, fire_particle_size;
+    static wf_option fire_particles, fire_particle_size, fire_gpu_simulation;
 
     ~FireAnimation();
     void init(wayfire_view view, wf_option duration, wf_animation_type type) override;
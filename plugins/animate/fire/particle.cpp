@@ -3,14 +3,17 @@
 #include <core.hpp>
 #include <thread>
 #include <debug.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+static constexpr float slowdown = 0.8;
 
 void Particle::update(float time)
 {
     if (life <= 0) // ignore
         return;
 
-    const float slowdown = 0.8;
-
     pos += speed * 0.2f * slowdown;
     speed += g * 0.3f * slowdown;
 
@@ -33,26 +36,90 @@ void Particle::update(float time)
     }
 }
 
-ParticleSystem::ParticleSystem(int particles, ParticleIniter init_func)
+/* Number of update steps until the particle dies, i.e until its life
+ * drops to 0. The simulation doesn't depend on the elapsed time, so this is
+ * exact (up to float rounding on the GPU) */
+static uint32_t particle_lifetime_steps(const Particle& p)
+{
+    if (p.life <= 0)
+        return 0;
+
+    if (p.fade <= 0)
+        return std::numeric_limits<uint32_t>::max();
+
+    uint32_t steps = 0;
+    float life = p.life;
+    while (life > 0)
+    {
+        life -= p.fade * 0.3 * slowdown;
+        ++steps;
+    }
+
+    return steps;
+}
+
+static bool context_supports_gles3()
+{
+    auto version = (const char*)GL_CALL(glGetString(GL_VERSION));
+
+    int major = 0, minor = 0;
+    if (!version || std::sscanf(version, "OpenGL ES %d.%d", &major, &minor) != 2)
+        return false;
+
+    return major >= 3;
+}
+
+ParticleSystem::ParticleSystem(int particles, ParticleIniter init_func,
+    bool gpu_simulation)
 {
     this->pinit_func = init_func;
+    particles_alive.store(0);
+
+    if (gpu_simulation)
+        gpu.enabled = create_gpu_program();
 
     resize(particles);
     last_update_msec = get_current_time();
     create_program();
-
-    particles_alive.store(0);
 }
 
 ParticleSystem::~ParticleSystem()
 {
     OpenGL::render_begin();
     GL_CALL(glDeleteProgram(program.id));
+    if (gpu.enabled)
+    {
+        destroy_gpu_buffers();
+        GL_CALL(glDeleteProgram(gpu.program));
+    }
     OpenGL::render_end();
 }
 
 int ParticleSystem::spawn(int num)
 {
+    if (gpu.enabled)
+    {
+        /* Only initialize the particles here, they are uploaded to the GPU
+         * in the next update() */
+        int spawned = 0;
+        for (size_t i = 0; i < ps.size() && spawned < num; i++)
+        {
+            if (gpu.death_step[i] <= gpu.step)
+            {
+                pinit_func(ps[i]);
+                auto lifetime = particle_lifetime_steps(ps[i]);
+                gpu.death_step[i] = gpu.step +
+                    std::min(lifetime, UINT32_MAX - gpu.step);
+                gpu.pending_spawns.push_back(i);
+
+                ++spawned;
+                ++particles_alive;
+            }
+        }
+
+        return spawned;
+    }
+
     // TODO: multithread this
     int spawned = 0;
     for (size_t i = 0; i < ps.size() && spawned < num; i++)
@@ -73,6 +140,22 @@ void ParticleSystem::resize(int num)
     if (num == (int)ps.size())
         return;
 
+    if (gpu.enabled)
+    {
+        /* The GPU buffers are reallocated on the next update(), because
+         * resize() may be called without a GL context */
+        ps.resize(num);
+        gpu.death_step.resize(num, 0);
+
+        auto& pending = gpu.pending_spawns;
+        pending.erase(std::remove_if(pending.begin(), pending.end(),
+                [=] (int i) { return i >= num; }), pending.end());
+
+        particles_alive.store(std::count_if(gpu.death_step.begin(),
+                gpu.death_step.end(), [=] (uint32_t d) { return d > gpu.step; }));
+        return;
+    }
+
     // TODO: multithread this
     for (int i = num; i < (int)ps.size(); i++)
     {
@@ -148,6 +231,9 @@ void ParticleSystem::update()
     float time = (get_current_time() - last_update_msec) / 16.0;
     last_update_msec = get_current_time();
 
+    if (gpu.enabled)
+        return update_gpu();
+
     exec_worker_threads([=] (int start, int end) {
         update_worker(time, start, end);
     });
@@ -172,12 +258,192 @@ void ParticleSystem::create_program()
     program.color     = GL_CALL(glGetAttribLocation(program.id, "color"));
     program.matrix    = GL_CALL(glGetUniformLocation(program.id, "matrix"));
     program.smoothing = GL_CALL(glGetUniformLocation(program.id, "smoothing"));
+    program.color_scale = GL_CALL(glGetUniformLocation(program.id, "color_scale"));
 
     OpenGL::render_end();
 }
 
+bool ParticleSystem::create_gpu_program()
+{
+    OpenGL::render_begin();
+    if (!context_supports_gles3())
+    {
+        log_info("fire: GLES 3.0 is not available, "
+            "falling back to CPU particle simulation");
+        OpenGL::render_end();
+        return false;
+    }
+
+    /* We can't use OpenGL::create_program_from_source(), because the
+     * transform feedback varyings have to be set before linking */
+    auto vs = OpenGL::compile_shader(particle_update_vert_source, GL_VERTEX_SHADER);
+    auto fs = OpenGL::compile_shader(particle_update_frag_source, GL_FRAGMENT_SHADER);
+
+    gpu.program = GL_CALL(glCreateProgram());
+    GL_CALL(glAttachShader(gpu.program, vs));
+    GL_CALL(glAttachShader(gpu.program, fs));
+
+    static const char *varyings[] = {
+        "out_color", "out_motion", "out_gravity", "out_life"
+    };
+    GL_CALL(glTransformFeedbackVaryings(gpu.program, 4, varyings,
+            GL_INTERLEAVED_ATTRIBS));
+    GL_CALL(glLinkProgram(gpu.program));
+
+    GL_CALL(glDeleteShader(vs));
+    GL_CALL(glDeleteShader(fs));
+
+    GLint linked = GL_FALSE;
+    GL_CALL(glGetProgramiv(gpu.program, GL_LINK_STATUS, &linked));
+    if (linked == GL_FALSE)
+    {
+        log_error("fire: failed to link particle update program, "
+            "falling back to CPU particle simulation");
+        GL_CALL(glDeleteProgram(gpu.program));
+        gpu.program = 0;
+    }
+
+    OpenGL::render_end();
+    return gpu.program != 0;
+}
+
+void ParticleSystem::destroy_gpu_buffers()
+{
+    if (gpu.allocated)
+    {
+        GL_CALL(glDeleteBuffers(2, gpu.buffers));
+    }
+
+    gpu.buffers[0] = gpu.buffers[1] = 0;
+    gpu.allocated = 0;
+}
+
+void ParticleSystem::allocate_gpu_buffers()
+{
+    int num = ps.size();
+    if (num == gpu.allocated)
+        return;
+
+    /* Zero-filled particles have life = 0, i.e they are dead */
+    std::vector<float> zero(num * floats_per_gpu_particle, 0.0f);
+    const size_t particle_bytes = floats_per_gpu_particle * sizeof(float);
+
+    GLuint buffers[2];
+    GL_CALL(glGenBuffers(2, buffers));
+    for (int i = 0; i < 2; i++)
+    {
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, buffers[i]));
+        GL_CALL(glBufferData(GL_ARRAY_BUFFER, num * particle_bytes,
+                zero.data(), GL_DYNAMIC_COPY));
+    }
+
+    /* Keep the surviving particles */
+    int keep = std::min(num, gpu.allocated);
+    if (keep > 0)
+    {
+        GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, gpu.buffers[gpu.current]));
+        GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[0]));
+        GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                0, 0, keep * particle_bytes));
+        GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+        GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+    }
+
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+    destroy_gpu_buffers();
+    gpu.buffers[0] = buffers[0];
+    gpu.buffers[1] = buffers[1];
+    gpu.current = 0;
+    gpu.allocated = num;
+}
+
+void ParticleSystem::upload_gpu_spawns()
+{
+    auto& pending = gpu.pending_spawns;
+    if (pending.empty())
+        return;
+
+    std::sort(pending.begin(), pending.end());
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, gpu.buffers[gpu.current]));
+
+    /* Upload consecutive slots with a single call */
+    std::vector<float> data;
+    size_t run_start = 0;
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        const auto& p = ps[pending[i]];
+        data.insert(data.end(), {
+            p.color.r, p.color.g, p.color.b, p.color.a,
+            p.pos.x, p.pos.y, p.speed.x, p.speed.y,
+            p.g.x, p.g.y, p.start_pos.x, p.start_pos.y,
+            p.life, p.fade, p.radius, p.base_radius,
+        });
+
+        bool run_ends = (i + 1 == pending.size() ||
+            pending[i + 1] != pending[i] + 1);
+        if (run_ends)
+        {
+            GL_CALL(glBufferSubData(GL_ARRAY_BUFFER,
+                    pending[run_start] * floats_per_gpu_particle * sizeof(float),
+                    data.size() * sizeof(float), data.data()));
+
+            data.clear();
+            run_start = i + 1;
+        }
+    }
+
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    pending.clear();
+}
+
+void ParticleSystem::update_gpu()
+{
+    OpenGL::render_begin();
+    allocate_gpu_buffers();
+    upload_gpu_spawns();
+
+    const GLsizei stride = floats_per_gpu_particle * sizeof(float);
+    GL_CALL(glUseProgram(gpu.program));
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, gpu.buffers[gpu.current]));
+    for (int i = 0; i < 4; i++)
+    {
+        GL_CALL(glEnableVertexAttribArray(i));
+        GL_CALL(glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, stride,
+                (void*)(i * 4 * sizeof(float))));
+    }
+
+    GL_CALL(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0,
+            gpu.buffers[1 - gpu.current]));
+
+    GL_CALL(glEnable(GL_RASTERIZER_DISCARD));
+    GL_CALL(glBeginTransformFeedback(GL_POINTS));
+    GL_CALL(glDrawArrays(GL_POINTS, 0, gpu.allocated));
+    GL_CALL(glEndTransformFeedback());
+    GL_CALL(glDisable(GL_RASTERIZER_DISCARD));
+
+    GL_CALL(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0));
+    for (int i = 0; i < 4; i++)
+    {
+        GL_CALL(glDisableVertexAttribArray(i));
+    }
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    GL_CALL(glUseProgram(0));
+    OpenGL::render_end();
+
+    gpu.current = 1 - gpu.current;
+    ++gpu.step;
+
+    particles_alive.store(std::count_if(gpu.death_step.begin(),
+            gpu.death_step.end(), [=] (uint32_t d) { return d > gpu.step; }));
+}
+
 void ParticleSystem::render(glm::mat4 matrix)
 {
+    /* Nothing simulated yet */
+    if (gpu.enabled && !gpu.allocated)
+        return;
+
     GL_CALL(glUseProgram(program.id));
 
     static float vertex_data[] = {
@@ -193,16 +459,34 @@ void ParticleSystem::render(glm::mat4 matrix)
                                   false, 0, vertex_data));
     GL_CALL(glVertexAttribDivisor(program.position, 0));
 
+    /* In GPU mode, the per-particle attributes are read directly from the
+     * last transform feedback buffer */
+    const GLsizei stride = floats_per_gpu_particle * sizeof(float);
+    const void *radius_data = radius.data();
+    const void *center_data = center.data();
+    const void *color_data = color.data();
+    GLsizei radius_stride = 0, center_stride = 0, color_stride = 0;
+    int count = ps.size();
+    if (gpu.enabled)
+    {
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, gpu.buffers[gpu.current]));
+        color_data = (void*)(0 * sizeof(float));
+        center_data = (void*)(4 * sizeof(float));
+        radius_data = (void*)(14 * sizeof(float));
+        radius_stride = center_stride = color_stride = stride;
+        count = gpu.allocated;
+    }
+
     // particle radius
     GL_CALL(glEnableVertexAttribArray(program.radius));
     GL_CALL(glVertexAttribPointer(program.radius, 1, GL_FLOAT,
-                                  false, 0, radius.data()));
+                                  false, radius_stride, radius_data));
     GL_CALL(glVertexAttribDivisor(program.radius, 1));;
 
     // particle center (offset)
     GL_CALL(glEnableVertexAttribArray(program.center));
     GL_CALL(glVertexAttribPointer(program.center, 2, GL_FLOAT,
-                                  false, 0, center.data()));
+                                  false, center_stride, center_data));
     GL_CALL(glVertexAttribDivisor(program.center, 1));
 
     // matrix
@@ -211,22 +495,38 @@ void ParticleSystem::render(glm::mat4 matrix)
     GL_CALL(glEnableVertexAttribArray(program.color));
     GL_CALL(glVertexAttribDivisor(program.color, 1));
 
-    /* Darken the background */
-    GL_CALL(glVertexAttribPointer(program.color, 4, GL_FLOAT,
-                                  false, 0, dark_color.data()));
+    /* Darken the background. On the CPU we keep a separate array with the
+     * darkened colors, on the GPU we scale the particle color instead */
+    if (gpu.enabled)
+    {
+        GL_CALL(glVertexAttribPointer(program.color, 4, GL_FLOAT,
+                                      false, color_stride, color_data));
+        GL_CALL(glUniform1f(program.color_scale, 0.5f));
+    } else
+    {
+        GL_CALL(glVertexAttribPointer(program.color, 4, GL_FLOAT,
+                                      false, 0, dark_color.data()));
+        GL_CALL(glUniform1f(program.color_scale, 1.0f));
+    }
 
     GL_CALL(glEnable(GL_BLEND));
     GL_CALL(glBlendFunc(GL_ZERO, GL_ONE_MINUS_SRC_ALPHA));
     GL_CALL(glUniform1f(program.smoothing, 0.7f));
     // TODO: optimize shaders for this case
-    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, ps.size()));
+    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, count));
 
     // particle color
     GL_CALL(glVertexAttribPointer(program.color, 4, GL_FLOAT,
-                                  false, 0, color.data()));
+                                  false, color_stride, color_data));
+    GL_CALL(glUniform1f(program.color_scale, 1.0f));
     GL_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE));
     GL_CALL(glUniform1f(program.smoothing, 0.5f));
-    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, ps.size()));
+    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, count));
+
+    if (gpu.enabled)
+    {
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    }
 
     GL_CALL(glDisable(GL_BLEND));
 
@@ -31,9 +31,14 @@ class ParticleSystem
 {
     public:
         /* the user of this class has to set up a proper GL context
-         * before creating the ParticleSystem */
+         * before creating the ParticleSystem
+         *
+         * If gpu_simulation is set and the context supports GLES 3.0, the
+         * particles are simulated on the GPU with transform feedback, and
+         * the particle state never leaves GPU memory */
         ParticleSystem(int num_part,
-                       ParticleIniter part_init_func);
+                       ParticleIniter part_init_func,
+                       bool gpu_simulation = false);
         ~ParticleSystem();
 
         /* spawn at most num new particles.
@@ -76,17 +81,39 @@ class ParticleSystem
         static constexpr int center_per_particle = 2;
         std::vector<float> center;
 
+        /* GPU simulation state. Each particle is stored as 4 vec4's:
+         * color, (pos, speed), (g, start_pos), (life, fade, radius, base_radius)
+         * The CPU keeps only the step at which each particle dies, so that it
+         * knows which slots can be reused when spawning */
+        static constexpr int floats_per_gpu_particle = 16;
+        struct {
+            bool enabled = false;
+            GLuint program = 0;
+            GLuint buffers[2] = {0, 0};
+            int current = 0;
+            int allocated = 0;
+
+            uint32_t step = 0;
+            std::vector<uint32_t> death_step;
+            std::vector<int> pending_spawns;
+        } gpu;
 
         struct {
             GLuint id;
             GLuint radius, position, center, color;
-            GLuint smoothing;
+            GLuint smoothing, color_scale;
             GLuint matrix;
         } program;
 
         void exec_worker_threads(std::function<void(int, int)> spawn_worker);
         void update_worker(float time, int start, int end);
         void create_program();
+
+        bool create_gpu_program();
+        void destroy_gpu_buffers();
+        void allocate_gpu_buffers();
+        void upload_gpu_spawns();
+        void update_gpu();
 };
 
 
@@ -11,6 +11,7 @@ attribute mediump vec2 center;
 attribute mediump vec4 color;
 
 uniform mat4 matrix;
+uniform mediump float color_scale;
 
 varying mediump vec2 uv;
 varying mediump vec4 out_color;
@@ -21,7 +22,7 @@ void main() {
     gl_Position = matrix * vec4(center.x + uv.x * 0.75, center.y + uv.y, 0.0, 1.0);
 
     R = radius;
-    out_color = color;
+    out_color = color * color_scale;
 }
 )";
 
@@ -50,4 +51,62 @@ void main()
 }
 )";
 
+/* Transform feedback program which advances the particles by one step.
+ * It mirrors Particle::update() */
+static const char *particle_update_vert_source =
+R"(
+#version 300 es
+
+layout(location = 0) in vec4 in_color;
+layout(location = 1) in vec4 in_motion;  // pos.xy, speed.xy
+layout(location = 2) in vec4 in_gravity; // g.xy, start_pos.xy
+layout(location = 3) in vec4 in_life;    // life, fade, radius, base_radius
+
+out vec4 out_color;
+out vec4 out_motion;
+out vec4 out_gravity;
+out vec4 out_life;
+
+void main()
+{
+    out_color = in_color;
+    out_motion = in_motion;
+    out_gravity = in_gravity;
+    out_life = in_life;
+
+    if (in_life.x <= 0.0)
+        return;
+
+    const float slowdown = 0.8;
+    vec2 pos = in_motion.xy + in_motion.zw * 0.2 * slowdown;
+    vec2 speed = in_motion.zw + in_gravity.xy * 0.3 * slowdown;
+
+    float life = in_life.x - in_life.y * 0.3 * slowdown;
+    float alpha = in_color.a / in_life.x * life;
+    float radius = in_life.w * sqrt(max(life, 0.0));
+
+    vec2 g = vec2(in_gravity.z < pos.x ? -1.0 : 1.0, in_gravity.y);
+    if (life <= 0.0)
+        pos = vec2(-10000.0, -10000.0);
+
+    out_color = vec4(in_color.rgb, alpha);
+    out_motion = vec4(pos, speed);
+    out_gravity = vec4(g, in_gravity.zw);
+    out_life = vec4(life, in_life.y, radius, in_life.w);
+}
+)";
+
+static const char *particle_update_frag_source =
+R"(
+#version 300 es
+
+precision mediump float;
+out vec4 frag_color;
+
+void main()
+{
+    frag_color = vec4(0.0);
+}
+)";
+
 #endif /* end of include guard: PARTICLE_ANIMATION_SHADER */
@@ -2,6 +2,7 @@
 #include <debug.hpp>
 #include <output.hpp>
 #include <workspace-manager.hpp>
+#include <gpu-profiler.hpp>
 
 static const char* blur_blend_vertex_shader = R"(
 #version 100
@@ -155,7 +156,11 @@ void wf_blur_base::pre_render(uint32_t src_tex, wlr_box src_box,
     int scaled_width = std::max(1, damage_box.width / degrade);
     int scaled_height = std::max(1, damage_box.height / degrade);
 
-    int r = blur_fb0(scaled_width, scaled_height);
+    int r;
+    {
+        wf::gpu_profiler::scope_t profile("blur passes");
+        r = blur_fb0(scaled_width, scaled_height);
+    }
 
     /* Make sure the result is always fb[1], because that's what is used in render() */
     if (r != 0)
@@ -6,6 +6,7 @@
 #include <render-manager.hpp>
 #include <workspace-manager.hpp>
 
+#include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <img.hpp>
 
@@ -100,7 +101,6 @@ class wayfire_cube : public wf::plugin_interface_t
         animation.duration.start();
 
         background_mode = section->get_option("background_mode", "simple");
-        reload_background();
 
         auto button = section->get_option("activate", "<alt> <ctrl> BTN_LEFT");
         activate_binding = [=] (uint32_t, int32_t, int32_t) {
@@ -152,11 +152,9 @@ class wayfire_cube : public wf::plugin_interface_t
         animation.offset_z = {identity_z_offset + Z_OFFSET_NEAR,
             identity_z_offset + Z_OFFSET_NEAR};
 
+        /* The program and the background are loaded on the first frame of
+         * the cube, so that outputs where it is never used don't pay for them */
         renderer = [=] (const wf_framebuffer& dest) {render(dest);};
-
-        OpenGL::render_begin(output->render->get_target_framebuffer());
-        load_program();
-        OpenGL::render_end();
     }
 
     void load_program()
@@ -418,29 +416,71 @@ class wayfire_cube : public wf::plugin_interface_t
         animation.view = zoom_translate * rotation * view;
     }
 
+    /* Check whether the i-th side of the cube faces the camera with the
+     * current rotation and zoom. Sides turned away from the camera are
+     * hidden behind the front sides, so their streams don't need updates. */
+    bool is_side_visible(int i)
+    {
+        /* Deformation bends the sides, so they may become visible earlier */
+        if (tessellation_support && use_deform->as_cached_int())
+            return true;
+
+        /* Use the same model and view matrices as for rendering. The output
+         * transform is left out: it only rotates the side in its own plane
+         * and the projected image in the screen plane. */
+        auto model_view = animation.view * calculate_zoom_matrix() *
+            calculate_model_matrix(i, glm::mat4(1.0));
+
+        auto center = model_view * glm::vec4(0, 0, 0, 1);
+        auto normal = model_view * glm::vec4(0, 0, 1, 0);
+
+        /* Allow a small margin so that sides which are almost perpendicular
+         * to the screen are still updated */
+        const float visibility_threshold = 0.1;
+        return glm::dot(glm::normalize(glm::vec3(normal)),
+            glm::normalize(glm::vec3(center))) < visibility_threshold;
+    }
+
+    /* Update the streams of the visible sides. Streams of hidden sides are
+     * stopped and keep their last contents. When they become visible again,
+     * they are restarted with a full repaint, because the damage they missed
+     * in the meantime is lost.
+     *
+     * Visible streams are repainted only where they have been damaged. */
     void update_workspace_streams()
     {
         auto cws = output->workspace->get_current_workspace();
         for(size_t i = 0; i < streams.size(); i++)
         {
-            if (!streams[i].running)
+            int index = (cws.x + i) % streams.size();
+            auto& stream = streams[index];
+
+            if (!is_side_visible(i))
+            {
+                if (stream.running)
+                    output->render->workspace_stream_stop(stream);
+            } else if (!stream.running)
             {
-                streams[i].ws = {(int)i, cws.y};
-                output->render->workspace_stream_start(streams[i]);
+                stream.ws = {index, cws.y};
+                output->render->workspace_stream_start(stream);
             } else
             {
-                output->render->workspace_stream_update(streams[i]);
+                output->render->workspace_stream_update(stream);
             }
         }
     }
 
-    glm::mat4 calculate_vp_matrix(const wf_framebuffer& dest)
+    glm::mat4 calculate_zoom_matrix()
     {
         float zoom_factor = animation.duration.progress(animation.zoom);
-        auto scale_matrix = glm::scale(glm::mat4(1.0),
+        return glm::scale(glm::mat4(1.0),
             glm::vec3(1. / zoom_factor, 1. / zoom_factor, 1. / zoom_factor));
+    }
 
-        return dest.transform * animation.projection * animation.view * scale_matrix;
+    glm::mat4 calculate_vp_matrix(const wf_framebuffer& dest)
+    {
+        return dest.transform * animation.projection * animation.view *
+            calculate_zoom_matrix();
     }
 
     /* Calculate the base model matrix for the i-th side of the cube */
@@ -464,6 +504,11 @@ class wayfire_cube : public wf::plugin_interface_t
         for(size_t i = 0; i < streams.size(); i++)
         {
             int index = (cws.x + i) % streams.size();
+
+            /* The side has never been visible, so its stream is empty */
+            if (streams[index].buffer.tex == (uint32_t)-1)
+                continue;
+
             GL_CALL(glBindTexture(GL_TEXTURE_2D, streams[index].buffer.tex));
 
             auto model = calculate_model_matrix(i, fb_transform);
@@ -619,6 +664,11 @@ class wayfire_cube : public wf::plugin_interface_t
         OpenGL::render_begin();
         for (size_t i = 0; i < streams.size(); i++)
             streams[i].buffer.release();
+
+        if (program.id != (uint32_t)-1)
+        {
+            GL_CALL(glDeleteProgram(program.id));
+        }
         OpenGL::render_end();
 
         output->rem_binding(&activate_binding);
@@ -38,42 +38,13 @@ void wf_cube_background_cubemap::create_program()
 
 void wf_cube_background_cubemap::reload_texture()
 {
-    if (last_background_image == background_image->as_string())
+    /* The texture is always created on the first call, so that it is never
+     * null, even with an empty image path */
+    if (texture && last_background_image == background_image->as_string())
         return;
 
     last_background_image = background_image->as_string();
-
-    OpenGL::render_begin();
-    if (tex == (uint32_t)-1)
-    {
-        GL_CALL(glGenTextures(1, &tex));
-    }
-
-    GL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, tex));
-    for (int i = 0; i < 6; i++)
-    {
-        if (!image_io::load_from_file(last_background_image, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i))
-        {
-            log_error("Failed to load cubemap background image from \"%s\".",
-                last_background_image.c_str());
-
-            GL_CALL(glDeleteTextures(1, &tex));
-            tex = -1;
-            break;
-        }
-    }
-
-    if (tex != (uint32_t)-1)
-    {
-        GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-        GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-        GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-        GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-        GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
-    }
-
-    GL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
-    OpenGL::render_end();
+    texture = image_io::get_texture(last_background_image, GL_TEXTURE_CUBE_MAP);
 }
 
 #include "cubemap-vertex-data.hpp"
@@ -84,7 +55,7 @@ void wf_cube_background_cubemap::render_frame(const wf_framebuffer& fb,
     reload_texture();
 
     OpenGL::render_begin(fb);
-    if (tex == (uint32_t)-1)
+    if (texture->failed)
     {
         GL_CALL(glClearColor(TEX_ERROR_FLAG_COLOR));
         GL_CALL(glClear(GL_COLOR_BUFFER_BIT));
@@ -94,7 +65,7 @@ void wf_cube_background_cubemap::render_frame(const wf_framebuffer& fb,
     GL_CALL(glUseProgram(program));
     GL_CALL(glDepthMask(GL_FALSE));
 
-    GL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, tex));
+    GL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, texture->tex));
 
     GL_CALL(glEnableVertexAttribArray(posID));
     GL_CALL(glVertexAttribPointer(posID, 3, GL_FLOAT, GL_FALSE, 0, skyboxVertices));
@@ -2,6 +2,7 @@
 #define WF_CUBE_CUBEMAP_HPP
 
 #include "cube-background.hpp"
+#include <img.hpp>
 
 class wf_cube_background_cubemap : public wf_cube_background_base
 {
@@ -16,9 +17,11 @@ class wf_cube_background_cubemap : public wf_cube_background_base
     void reload_texture();
     void create_program();
 
-    GLuint program = -1, tex = -1;
+    GLuint program = -1;
     GLuint matrixID, posID;
 
+    std::shared_ptr<image_io::texture_t> texture;
+
     std::string last_background_image;
     wf_option background_image;
 };
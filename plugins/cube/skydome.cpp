@@ -49,37 +49,13 @@ void wf_cube_background_skydome::load_program()
 
 void wf_cube_background_skydome::reload_texture()
 {
-    if (last_background_image == background_image->as_string())
+    /* The texture is always created on the first call, so that it is never
+     * null, even with an empty image path */
+    if (texture && last_background_image == background_image->as_string())
         return;
 
     last_background_image = background_image->as_string();
-    OpenGL::render_begin();
-
-    if (tex == (uint32_t)-1)
-    {
-        GL_CALL(glGenTextures(1, &tex));
-    }
-
-    GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
-
-    if (image_io::load_from_file(last_background_image, GL_TEXTURE_2D))
-    {
-        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-    }
-    else
-    {
-        log_error("Failed to load skydome image from \"%s\".",
-            last_background_image.c_str());
-        GL_CALL(glDeleteTextures(1, &tex));
-        tex = -1;
-    }
-
-    GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
-
-    OpenGL::render_end();
+    texture = image_io::get_texture(last_background_image, GL_TEXTURE_2D);
 }
 
 void wf_cube_background_skydome::fill_vertices()
@@ -142,7 +118,7 @@ void wf_cube_background_skydome::render_frame(const wf_framebuffer& fb,
     fill_vertices();
     reload_texture();
 
-    if (tex == (uint32_t)-1)
+    if (texture->failed)
     {
         GL_CALL(glClearColor(TEX_ERROR_FLAG_COLOR));
         GL_CALL(glClear(GL_COLOR_BUFFER_BIT));
@@ -179,7 +155,7 @@ void wf_cube_background_skydome::render_frame(const wf_framebuffer& fb,
     GL_CALL(glUniformMatrix4fv(modelID, 1, GL_FALSE, &model[0][0]));
 
     GL_CALL(glActiveTexture(GL_TEXTURE0));
-    GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, texture->tex));
 
     GL_CALL(glDrawElements(GL_TRIANGLES,
             6 * SKYDOME_GRID_WIDTH * (SKYDOME_GRID_HEIGHT - 2),
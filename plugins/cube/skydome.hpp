@@ -3,6 +3,7 @@
 
 #include "cube-background.hpp"
 #include "output.hpp"
+#include <img.hpp>
 #include <vector>
 
 class wf_cube_background_skydome : public wf_cube_background_base
@@ -21,9 +22,11 @@ class wf_cube_background_skydome : public wf_cube_background_base
     void fill_vertices();
     void reload_texture();
 
-    GLuint program = -1, tex = -1;
+    GLuint program = -1;
     GLuint posID, uvID, modelID, vpID;
 
+    std::shared_ptr<image_io::texture_t> texture;
+
     std::vector<GLfloat> vertices;
     std::vector<GLfloat> coords;
     std::vector<GLuint> indices;
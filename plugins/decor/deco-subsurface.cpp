@@ -12,8 +12,7 @@
 #include <view-transform.hpp>
 #include <signal-definitions.hpp>
 #include "deco-subsurface.hpp"
-
-#include <cairo.h>
+#include "deco-title.hpp"
 
 extern "C"
 {
@@ -28,49 +27,6 @@ const int titlebar_thickness = 30;
 const int resize_edge_threshold = 5;
 const int normal_thickness = resize_edge_threshold;
 
-GLuint get_text_texture(int width, int height,
-    std::string text, std::string cairo_font)
-{
-    const auto format = CAIRO_FORMAT_ARGB32;
-    auto surface = cairo_image_surface_create(format, width, height);
-    auto cr = cairo_create(surface);
-
-    const float font_scale = 0.8;
-    const float font_size = height * font_scale;
-
-    // render text
-    cairo_select_font_face(cr, cairo_font.c_str(), CAIRO_FONT_SLANT_NORMAL,
-        CAIRO_FONT_WEIGHT_NORMAL);
-    cairo_set_source_rgba(cr, 1, 1, 1, 1);
-
-    cairo_set_font_size(cr, font_size);
-
-    cairo_text_extents_t ext;
-    cairo_text_extents(cr, text.c_str(), &ext);
-
-    cairo_move_to(cr, normal_thickness, font_size);
-    cairo_show_text(cr, text.c_str());
-
-    cairo_destroy(cr);
-
-    auto src = cairo_image_surface_get_data(surface);
-
-    GLuint tex;
-    GL_CALL(glGenTextures(1, &tex));
-    GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
-
-    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-    GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
-            GL_RGBA, GL_UNSIGNED_BYTE, src));
-
-    cairo_surface_destroy(surface);
-
-    return tex;
-}
-
 class simple_decoration_surface : public wf::surface_interface_t,
     public wf::compositor_surface_t, public wf_decorator_frame_t
 {
@@ -88,8 +44,10 @@ class simple_decoration_surface : public wf::surface_interface_t,
     float border_color[4] = {0.15f, 0.15f, 0.15f, 0.8f};
     float border_color_inactive[4] = {0.25f, 0.25f, 0.25f, 0.95f};
 
-    GLuint tex = -1;
-
+    /* The title is rendered from a glyph atlas shared between decorations */
+    std::shared_ptr<wf::decor::glyph_atlas_t> title_atlas;
+    wf::decor::title_layout_t title_layout;
+    bool title_dirty = true;
 
   public:
     simple_decoration_surface(wayfire_view view, wf_option font)
@@ -101,7 +59,10 @@ class simple_decoration_surface : public wf::surface_interface_t,
         title_set = [=] (wf::signal_data_t *data)
         {
             if (get_signaled_view(data) == view)
-                notify_view_resized(view->get_wm_geometry());
+            {
+                title_dirty = true;
+                view->damage();
+            }
         };
         view->connect_signal("title-changed", &title_set);
 
@@ -134,6 +95,27 @@ class simple_decoration_surface : public wf::surface_interface_t,
         return {width, height};
     }
 
+    /* Make sure the title layout matches the current title, size and font.
+     * Only glyphs which haven't been used before are uploaded. */
+    void update_title_layout(const wf_framebuffer& fb)
+    {
+        int titlebar_pixels = titlebar * fb.scale;
+        auto font = font_option->as_string();
+        if (!title_atlas || title_atlas->font != font ||
+            title_atlas->titlebar_height != titlebar_pixels)
+        {
+            title_atlas = wf::decor::get_glyph_atlas(font, titlebar_pixels);
+            title_dirty = true;
+        }
+
+        if (title_dirty || !title_atlas->is_valid(title_layout))
+        {
+            title_atlas->layout(view->get_title(), normal_thickness,
+                width * fb.scale, title_layout);
+            title_dirty = false;
+        }
+    }
+
     void render_box(const wf_framebuffer& fb, int x, int y,
         const wlr_box& scissor)
     {
@@ -155,21 +137,9 @@ class simple_decoration_surface : public wf::surface_interface_t,
         wlr_render_quad_with_matrix(wf::get_core().renderer,
             active ? border_color : border_color_inactive, matrix);
 
-        if (tex == (uint)-1)
-        {
-            tex = get_text_texture(width * fb.scale, titlebar * fb.scale,
-                view->get_title(), font_option->as_string());
-        }
-
-        gl_geometry gg;
-        gg.x1 = x + fb.geometry.x;
-        gg.y1 = y + fb.geometry.y;
-        gg.x2 = gg.x1 + width;
-        gg.y2 = gg.y1 + titlebar;
-
-        OpenGL::render_transformed_texture(tex, gg, {},
-            fb.get_orthographic_projection(), {1, 1, 1, 1},
-            TEXTURE_TRANSFORM_INVERT_Y);
+        update_title_layout(fb);
+        title_atlas->render(title_layout, x + fb.geometry.x,
+            y + fb.geometry.y, fb.scale, fb.get_orthographic_projection());
 
         GL_CALL(glUseProgram(0));
         OpenGL::render_end();
@@ -321,13 +291,8 @@ class simple_decoration_surface : public wf::surface_interface_t,
     virtual void notify_view_resized(wf_geometry view_geometry) override
     {
         view->damage();
-
-        if (tex != (uint32_t)-1)
-        {
-            GL_CALL(glDeleteTextures(1, &tex));
-        }
-
-        tex = -1;
+        if (width != view_geometry.width)
+            title_dirty = true;
 
         width = view_geometry.width;
         height = view_geometry.height;
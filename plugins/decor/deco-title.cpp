@@ -0,0 +1,345 @@
+#include <cmath>
+#include <map>
+#include <algorithm>
+#include <debug.hpp>
+#include "deco-title.hpp"
+
+static const char* title_vertex_source =
+R"(
+#version 100
+
+attribute highp vec2 position;
+attribute highp vec2 uvPosition;
+
+varying highp vec2 uvpos;
+
+uniform mat4 MVP;
+uniform highp vec2 origin;
+uniform highp float scale;
+
+void main() {
+    gl_Position = MVP * vec4(origin + position / scale, 0.0, 1.0);
+    uvpos = uvPosition;
+}
+)";
+
+static const char* title_fragment_source =
+R"(
+#version 100
+
+varying highp vec2 uvpos;
+
+uniform sampler2D smp;
+uniform mediump vec4 color;
+
+void main()
+{
+    mediump vec4 tex_color = texture2D(smp, uvpos);
+    tex_color.rgb = tex_color.rgb * color.a;
+    gl_FragColor = tex_color * color;
+}
+)";
+
+/* Big enough for the glyphs of several scripts at usual titlebar sizes */
+static const int atlas_size = 1024;
+
+/* Ratio of the font size to the titlebar height */
+static const float font_scale = 0.8;
+
+namespace wf
+{
+namespace decor
+{
+glyph_atlas_t::glyph_atlas_t(std::string font, int titlebar_height)
+    : font(font), titlebar_height(titlebar_height)
+{
+    font_size = titlebar_height * font_scale;
+
+    auto face = cairo_toy_font_face_create(font.c_str(),
+        CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+
+    cairo_matrix_t font_matrix, ctm;
+    cairo_matrix_init_scale(&font_matrix, font_size, font_size);
+    cairo_matrix_init_identity(&ctm);
+
+    auto options = cairo_font_options_create();
+    scaled_font = cairo_scaled_font_create(face, &font_matrix, &ctm, options);
+    cairo_font_options_destroy(options);
+    cairo_font_face_destroy(face);
+
+    if (cairo_scaled_font_status(scaled_font) != CAIRO_STATUS_SUCCESS)
+        log_error("decoration: failed to load font %s", font.c_str());
+}
+
+glyph_atlas_t::~glyph_atlas_t()
+{
+    cairo_scaled_font_destroy(scaled_font);
+
+    if (tex == (GLuint)-1)
+        return;
+
+    OpenGL::render_begin();
+    GL_CALL(glDeleteTextures(1, &tex));
+    GL_CALL(glDeleteProgram(program));
+    OpenGL::render_end();
+}
+
+void glyph_atlas_t::ensure_gl_resources()
+{
+    if (tex != (GLuint)-1)
+        return;
+
+    program = OpenGL::create_program_from_source(
+        title_vertex_source, title_fragment_source);
+
+    mvp_id      = GL_CALL(glGetUniformLocation(program, "MVP"));
+    origin_id   = GL_CALL(glGetUniformLocation(program, "origin"));
+    scale_id    = GL_CALL(glGetUniformLocation(program, "scale"));
+    color_id    = GL_CALL(glGetUniformLocation(program, "color"));
+    position_id = GL_CALL(glGetAttribLocation(program, "position"));
+    uv_id       = GL_CALL(glGetAttribLocation(program, "uvPosition"));
+
+    /* Start with a transparent atlas, so that sampling at the edges of the
+     * glyphs doesn't pick up garbage */
+    std::vector<uint8_t> empty(atlas_size * atlas_size * 4, 0);
+
+    GL_CALL(glGenTextures(1, &tex));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlas_size, atlas_size,
+            0, GL_RGBA, GL_UNSIGNED_BYTE, empty.data()));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
+const std::vector<cairo_glyph_t>& glyph_atlas_t::shape(const std::string& text)
+{
+    auto it = shaped_runs.find(text);
+    if (it != shaped_runs.end())
+        return it->second;
+
+    /* Titles of the same view rarely come back once they have changed,
+     * so just start over instead of tracking usage */
+    if (shaped_runs.size() >= max_cached_runs)
+        shaped_runs.clear();
+
+    cairo_glyph_t *glyph_list = nullptr;
+    int num_glyphs = 0;
+
+    auto& run = shaped_runs[text];
+    auto status = cairo_scaled_font_text_to_glyphs(scaled_font, 0, 0,
+        text.c_str(), text.length(), &glyph_list, &num_glyphs,
+        nullptr, nullptr, nullptr);
+
+    if (status == CAIRO_STATUS_SUCCESS)
+        run.assign(glyph_list, glyph_list + num_glyphs);
+
+    cairo_glyph_free(glyph_list);
+    return run;
+}
+
+void glyph_atlas_t::reset_atlas()
+{
+    glyphs.clear();
+    cursor_x = cursor_y = row_height = 0;
+    ++generation;
+}
+
+bool glyph_atlas_t::get_glyph(unsigned long index, const glyph_slot_t*& slot)
+{
+    auto it = glyphs.find(index);
+    if (it != glyphs.end())
+    {
+        slot = &it->second;
+        return true;
+    }
+
+    cairo_glyph_t glyph = {index, 0, 0};
+    cairo_text_extents_t ext;
+    cairo_scaled_font_glyph_extents(scaled_font, &glyph, 1, &ext);
+
+    glyph_slot_t& result = glyphs[index];
+    slot = &result;
+
+    /* Whitespace and other glyphs without ink */
+    if (ext.width <= 0 || ext.height <= 0)
+    {
+        result = {0, 0, 0, 0, 0, 0};
+        return true;
+    }
+
+    /* Leave a transparent pixel around each glyph for linear filtering */
+    result.offset_x = std::floor(ext.x_bearing) - 1;
+    result.offset_y = std::floor(ext.y_bearing) - 1;
+    result.width = std::ceil(ext.x_bearing + ext.width) - result.offset_x + 1;
+    result.height = std::ceil(ext.y_bearing + ext.height) - result.offset_y + 1;
+
+    if (cursor_x + result.width > atlas_size)
+    {
+        cursor_x = 0;
+        cursor_y += row_height;
+        row_height = 0;
+    }
+
+    if (cursor_y + result.height > atlas_size ||
+        result.width > atlas_size)
+    {
+        glyphs.erase(index);
+        slot = nullptr;
+        return false;
+    }
+
+    result.x = cursor_x;
+    result.y = cursor_y;
+    cursor_x += result.width;
+    row_height = std::max(row_height, result.height);
+
+    auto surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+        result.width, result.height);
+    auto cr = cairo_create(surface);
+    cairo_set_scaled_font(cr, scaled_font);
+    cairo_set_source_rgba(cr, 1, 1, 1, 1);
+
+    glyph.x = -result.offset_x;
+    glyph.y = -result.offset_y;
+    cairo_show_glyphs(cr, &glyph, 1);
+    cairo_destroy(cr);
+    cairo_surface_flush(surface);
+
+    /* The stride of ARGB32 surfaces is always width * 4, so the rows are
+     * tightly packed, as GLES2 expects */
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+    GL_CALL(glTexSubImage2D(GL_TEXTURE_2D, 0, result.x, result.y,
+            result.width, result.height, GL_RGBA, GL_UNSIGNED_BYTE,
+            cairo_image_surface_get_data(surface)));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+
+    cairo_surface_destroy(surface);
+    return true;
+}
+
+void glyph_atlas_t::layout(const std::string& text, int start_x,
+    int max_width, title_layout_t& out)
+{
+    ensure_gl_resources();
+    out.vertices.clear();
+
+    const auto& run = shape(text);
+    const float baseline = font_size;
+
+    /* The atlas might fill up in the middle of the run. In that case start
+     * with an empty atlas and try again. */
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        bool complete = true;
+        out.vertices.clear();
+
+        for (const auto& glyph : run)
+        {
+            const glyph_slot_t *slot;
+            if (!get_glyph(glyph.index, slot))
+            {
+                complete = false;
+                break;
+            }
+
+            if (slot->width == 0)
+                continue;
+
+            float x1 = std::round(start_x + glyph.x) + slot->offset_x;
+            float y1 = std::round(baseline + glyph.y) + slot->offset_y;
+            float x2 = x1 + slot->width;
+            float y2 = y1 + slot->height;
+
+            /* The rest of the title doesn't fit */
+            if (x2 > max_width)
+                break;
+
+            float u1 = 1.0f * slot->x / atlas_size;
+            float v1 = 1.0f * slot->y / atlas_size;
+            float u2 = 1.0f * (slot->x + slot->width) / atlas_size;
+            float v2 = 1.0f * (slot->y + slot->height) / atlas_size;
+
+            out.vertices.insert(out.vertices.end(), {
+                x1, y1, u1, v1,
+                x2, y1, u2, v1,
+                x2, y2, u2, v2,
+                x1, y1, u1, v1,
+                x2, y2, u2, v2,
+                x1, y2, u1, v2,
+            });
+        }
+
+        if (complete)
+            break;
+
+        reset_atlas();
+    }
+
+    out.generation = generation;
+}
+
+bool glyph_atlas_t::is_valid(const title_layout_t& layout) const
+{
+    return layout.generation == generation;
+}
+
+void glyph_atlas_t::render(const title_layout_t& layout, float x, float y,
+    float scale, const glm::mat4& projection)
+{
+    if (layout.vertices.empty())
+        return;
+
+    GL_CALL(glUseProgram(program));
+    GL_CALL(glActiveTexture(GL_TEXTURE0));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+
+    const GLsizei stride = 4 * sizeof(GLfloat);
+    GL_CALL(glVertexAttribPointer(position_id, 2, GL_FLOAT, GL_FALSE,
+            stride, layout.vertices.data()));
+    GL_CALL(glEnableVertexAttribArray(position_id));
+    GL_CALL(glVertexAttribPointer(uv_id, 2, GL_FLOAT, GL_FALSE,
+            stride, layout.vertices.data() + 2));
+    GL_CALL(glEnableVertexAttribArray(uv_id));
+
+    GL_CALL(glUniformMatrix4fv(mvp_id, 1, GL_FALSE, &projection[0][0]));
+    GL_CALL(glUniform2f(origin_id, x, y));
+    GL_CALL(glUniform1f(scale_id, scale));
+    GL_CALL(glUniform4f(color_id, 1, 1, 1, 1));
+
+    GL_CALL(glEnable(GL_BLEND));
+    GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+    GL_CALL(glDrawArrays(GL_TRIANGLES, 0, layout.vertices.size() / 4));
+
+    GL_CALL(glDisableVertexAttribArray(uv_id));
+    GL_CALL(glDisableVertexAttribArray(position_id));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
+std::shared_ptr<glyph_atlas_t> get_glyph_atlas(std::string font,
+    int titlebar_height)
+{
+    static std::map<std::pair<std::string, int>,
+        std::weak_ptr<glyph_atlas_t>> atlases;
+
+    auto& entry = atlases[{font, titlebar_height}];
+    if (auto atlas = entry.lock())
+        return atlas;
+
+    /* Drop entries of atlases which are no longer used */
+    for (auto it = atlases.begin(); it != atlases.end();)
+    {
+        if (it->second.expired() && &it->second != &entry)
+            it = atlases.erase(it);
+        else
+            ++it;
+    }
+
+    auto atlas = std::make_shared<glyph_atlas_t>(font, titlebar_height);
+    entry = atlas;
+    return atlas;
+}
+}
+}
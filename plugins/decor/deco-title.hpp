@@ -0,0 +1,94 @@
+#ifndef DECO_TITLE_HPP
+#define DECO_TITLE_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <opengl.hpp>
+
+#include <cairo.h>
+
+namespace wf
+{
+namespace decor
+{
+/* The result of laying out a title with a glyph atlas.
+ * Vertices are in pixels relative to the top-left corner of the titlebar,
+ * and are rendered as a single batch of textured quads. */
+struct title_layout_t
+{
+    /* The atlas generation the texture coordinates refer to */
+    uint64_t generation = 0;
+    /* x, y, u, v for each vertex, 6 vertices per glyph */
+    std::vector<GLfloat> vertices;
+};
+
+/* A texture atlas containing the glyphs of a single font at a single size.
+ *
+ * Glyphs are rasterized with cairo and uploaded to the atlas the first time
+ * they are used, and shaped runs are cached by their text, so that changing
+ * the title of a view only uploads the glyphs which weren't used before.
+ * Atlases are shared between all decorations with the same font and size. */
+class glyph_atlas_t
+{
+  public:
+    glyph_atlas_t(std::string font, int titlebar_height);
+    ~glyph_atlas_t();
+
+    const std::string font;
+    const int titlebar_height;
+
+    /* Lay out the given text starting at start_x, clipping it to max_width
+     * pixels. Must be called between OpenGL::render_begin() and render_end() */
+    void layout(const std::string& text, int start_x, int max_width,
+        title_layout_t& out);
+
+    /* Whether the layout still refers to valid glyphs in the atlas */
+    bool is_valid(const title_layout_t& layout) const;
+
+    /* Render a layout with its top-left corner at (x, y) in the coordinate
+     * system of the projection. Scale is the ratio of pixels to logical
+     * coordinates, i.e the output scale. */
+    void render(const title_layout_t& layout, float x, float y, float scale,
+        const glm::mat4& projection);
+
+  private:
+    struct glyph_slot_t
+    {
+        /* Position in the atlas in pixels */
+        int x, y, width, height;
+        /* Offset of the bitmap relative to the glyph origin */
+        int offset_x, offset_y;
+    };
+
+    cairo_scaled_font_t *scaled_font = nullptr;
+    float font_size;
+
+    GLuint tex = -1;
+    GLuint program = -1;
+    GLint mvp_id, origin_id, scale_id, color_id, position_id, uv_id;
+
+    uint64_t generation = 1;
+    int cursor_x = 0, cursor_y = 0, row_height = 0;
+    std::unordered_map<unsigned long, glyph_slot_t> glyphs;
+
+    static constexpr size_t max_cached_runs = 128;
+    std::unordered_map<std::string, std::vector<cairo_glyph_t>> shaped_runs;
+
+    void ensure_gl_resources();
+    const std::vector<cairo_glyph_t>& shape(const std::string& text);
+
+    /* Find or upload the glyph. Returns false if the atlas is full */
+    bool get_glyph(unsigned long index, const glyph_slot_t*& slot);
+    void reset_atlas();
+};
+
+/* Get the shared atlas for the given font and titlebar height in pixels,
+ * creating it if necessary. */
+std::shared_ptr<glyph_atlas_t> get_glyph_atlas(std::string font,
+    int titlebar_height);
+}
+}
+
+#endif /* end of include guard: DECO_TITLE_HPP */
@@ -4,6 +4,7 @@
 #include <map>
 #include <set>
 #include <regex>
+#include <functional>
 
 namespace wf
 {
@@ -62,28 +63,43 @@ namespace wf
 
         namespace matchers
         {
-            using func_t = std::function<bool(string, string)>;
-            func_t exact = [] (string text, string pattern)
+            /* A matcher with its argument already compiled in */
+            using func_t = std::function<bool(const string&)>;
+            using factory_t = std::function<func_t(string)>;
+
+            factory_t exact = [] (string pattern) -> func_t
             {
                 if (pattern == "any")
-                    return true;
+                    return [] (const string&) { return true; };
+
+                /* Patterns without special characters match only themselves,
+                 * no need to go through the regex engine */
+                if (pattern.find_first_of("\\^$.|?*+()[]{}") == string::npos)
+                    return [pattern] (const string& text) { return text == pattern; };
 
-                bool result = false;
+                std::shared_ptr<std::regex> regex;
                 try {
-                    result = std::regex_match(text, std::regex(pattern));
+                    regex = std::make_shared<std::regex> (pattern);
                 } catch (const std::exception& e) {
                     log_error ("Invalid regular expression: %s", pattern.c_str());
+                    return [] (const string&) { return false; };
                 }
 
-                return result;
+                return [regex] (const string& text)
+                {
+                    return std::regex_match(text, *regex);
+                };
             };
 
-            func_t contains = [] (string text, string pattern)
+            factory_t contains = [] (string pattern) -> func_t
             {
-                return text.find(pattern) != text.npos;
+                return [pattern] (const string& text)
+                {
+                    return text.find(pattern) != text.npos;
+                };
             };
 
-            std::map<string, func_t> matchers = {
+            std::map<string, factory_t> matchers = {
                 {"is", exact},
                 {"contains", contains},
             };
@@ -109,8 +125,8 @@ namespace wf
         struct single_expression_t : public expression_t
         {
             match_field field;
+            /* The matcher is compiled once, when the expression is parsed */
             matchers::func_t matcher;
-            string matcher_arg;
 
             single_expression_t(string expr)
             {
@@ -127,29 +143,28 @@ namespace wf
                     throw std::invalid_argument("Invalid match mode: " + tokens[1]);
 
                 this->field = match_fields[tokens[0]];
-                this->matcher = matchers::matchers[tokens[1]];
-                this->matcher_arg = tokens[2];
+                this->matcher = matchers::matchers[tokens[1]](tokens[2]);
             }
 
-            bool evaluate(const view_t& view) override
+            const string& get_field(const view_t& view)
             {
-                string view_field_data;
                 switch (this->field)
                 {
                     case FIELD_TITLE:
-                        view_field_data = view.title;
-                        break;
+                        return view.title;
                     case FIELD_APP_ID:
-                        view_field_data = view.app_id;
-                        break;
+                        return view.app_id;
                     case FIELD_TYPE:
-                        view_field_data = view.type;
-                        break;
+                        return view.type;
                     case FIELD_FOCUSEABLE:
-                        view_field_data = view.focuseable;
+                    default:
+                        return view.focuseable;
                 }
+            }
 
-                return this->matcher(view_field_data, this->matcher_arg);
+            bool evaluate(const view_t& view) override
+            {
+                return this->matcher(get_field(view));
             }
         };
 
@@ -6,6 +6,10 @@
 #include <core.hpp>
 #include <output.hpp>
 #include <workspace-manager.hpp>
+#include <signal-definitions.hpp>
+
+#include <unordered_map>
+#include <vector>
 
 namespace wf
 {
@@ -32,9 +36,18 @@ namespace wf
             return "unknown";
         };
 
+        /* Unique ids for parsed expressions, so that stale results of
+         * destroyed or reloaded matchers are never reused */
+        static uint64_t next_matcher_id = 0;
+
+        /* Ids of the matchers which were reloaded or destroyed since the last
+         * evaluation. Their cached results are evicted on the next one. */
+        static std::vector<uint64_t> retired_matcher_ids;
+
         class default_view_matcher : public view_matcher
         {
             std::unique_ptr<expression_t> expr;
+            uint64_t expr_id;
             wf_option match_option;
 
             wf_option_callback on_match_string_updated = [=] ()
@@ -46,7 +59,11 @@ namespace wf
                         match_option->as_string().c_str(), result.second.c_str());
                 }
 
+                if (this->expr)
+                    retired_matcher_ids.push_back(this->expr_id);
+
                 this->expr = std::move(result.first);
+                this->expr_id = next_matcher_id++;
             };
 
             public:
@@ -60,25 +77,139 @@ namespace wf
             virtual ~default_view_matcher()
             {
                 match_option->rem_updated_handler(&on_match_string_updated);
+                if (expr)
+                    retired_matcher_ids.push_back(expr_id);
             }
 
-            virtual bool matches(wayfire_view view) const
+            /* @return The parsed expression, or null if parsing failed */
+            expression_t *get_expression() const
             {
-                if (!expr || !view->is_mapped())
-                    return false;
-
-                view_t data;
-                data.title = view->get_title();
-                data.app_id = view->get_app_id();
-                data.type = get_view_type(view);
-                data.focuseable = view->is_focuseable() ?  "true" : "false";
+                return expr.get();
+            }
 
-                return expr->evaluate(data);
+            /* @return A unique id of the current expression */
+            uint64_t get_id() const
+            {
+                return expr_id;
             }
         };
 
         class matcher_plugin
         {
+            /* Attributes of a mapped view as seen by match expressions,
+             * together with the results of the matchers which were evaluated
+             * on them.
+             *
+             * Title and app-id are copied only when the view reports that
+             * they have changed. Type and focuseable are cheap and can change
+             * without a signal, so they are checked on each evaluation. The
+             * results are dropped whenever an attribute changes. */
+            struct view_state_t
+            {
+                view_t data;
+                /* Indexed by the id of the matcher */
+                std::unordered_map<uint64_t, bool> results;
+            };
+
+            /* The state is kept here instead of as custom data of the views,
+             * so that nothing of this plugin outlives it. Views are dropped
+             * when they are unmapped. */
+            std::unordered_map<view_interface_t*, view_state_t> views;
+
+            signal_callback_t on_title_changed = [=] (signal_data_t *data)
+            {
+                auto view = get_signaled_view(data);
+                auto it = views.find(view.get());
+                if (it != views.end())
+                {
+                    it->second.data.title = view->get_title();
+                    it->second.results.clear();
+                }
+            };
+
+            signal_callback_t on_app_id_changed = [=] (signal_data_t *data)
+            {
+                auto view = get_signaled_view(data);
+                auto it = views.find(view.get());
+                if (it != views.end())
+                {
+                    it->second.data.app_id = view->get_app_id();
+                    it->second.results.clear();
+                }
+            };
+
+            signal_callback_t on_view_unmap = [=] (signal_data_t *data)
+            {
+                drop_view(get_signaled_view(data).get());
+            };
+
+            void drop_view(view_interface_t *view)
+            {
+                view->disconnect_signal("title-changed", &on_title_changed);
+                view->disconnect_signal("app-id-changed", &on_app_id_changed);
+                view->disconnect_signal("unmap", &on_view_unmap);
+                views.erase(view);
+            }
+
+            view_state_t& get_view_state(wayfire_view view)
+            {
+                auto it = views.find(view.get());
+                if (it == views.end())
+                {
+                    it = views.emplace(view.get(), view_state_t{}).first;
+                    it->second.data.title = view->get_title();
+                    it->second.data.app_id = view->get_app_id();
+                    view->connect_signal("title-changed", &on_title_changed);
+                    view->connect_signal("app-id-changed", &on_app_id_changed);
+                    view->connect_signal("unmap", &on_view_unmap);
+                }
+
+                auto& state = it->second;
+                auto type = get_view_type(view);
+                auto focuseable = view->is_focuseable() ? "true" : "false";
+                if (type != state.data.type || focuseable != state.data.focuseable)
+                {
+                    state.data.type = type;
+                    state.data.focuseable = focuseable;
+                    state.results.clear();
+                }
+
+                return state;
+            }
+
+            void evict_retired_matchers()
+            {
+                if (retired_matcher_ids.empty())
+                    return;
+
+                for (auto& view : views)
+                {
+                    for (auto id : retired_matcher_ids)
+                        view.second.results.erase(id);
+                }
+
+                retired_matcher_ids.clear();
+            }
+
+            bool evaluate(const default_view_matcher& matcher, wayfire_view view)
+            {
+                auto expr = matcher.get_expression();
+                if (!expr || !view->is_mapped())
+                    return false;
+
+                evict_retired_matchers();
+
+                auto& state = get_view_state(view);
+                auto it = state.results.find(matcher.get_id());
+                if (it == state.results.end())
+                {
+                    it = state.results.emplace(matcher.get_id(),
+                        expr->evaluate(state.data)).first;
+                }
+
+                return it->second;
+            }
+
             signal_callback_t on_new_matcher_request = [=] (signal_data_t *data)
             {
                 auto ev = static_cast<match_signal*> (data);
@@ -92,7 +223,7 @@ namespace wf
                     dynamic_cast<default_view_matcher*> (ev->matcher.get());
 
                 if (expr)
-                    ev->result = expr->matches(ev->view);
+                    ev->result = evaluate(*expr, ev->view);
             };
 
             public:
@@ -103,6 +234,17 @@ namespace wf
                 wf::get_core().connect_signal(WF_MATCHER_EVALUATE_SIGNAL,
                     &on_matcher_evaluate);
             }
+
+            ~matcher_plugin()
+            {
+                wf::get_core().disconnect_signal(WF_MATCHER_CREATE_QUERY_SIGNAL,
+                    &on_new_matcher_request);
+                wf::get_core().disconnect_signal(WF_MATCHER_EVALUATE_SIGNAL,
+                    &on_matcher_evaluate);
+
+                while (!views.empty())
+                    drop_view(views.begin()->first);
+            }
         };
 
         class matcher_singleton : public wf::singleton_plugin_t<matcher_plugin>
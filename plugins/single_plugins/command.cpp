@@ -234,8 +234,11 @@ class wayfire_command : public wf::plugin_interface_t
 
         setup_bindings_from_config(config);
 
-        reload_config = [=] (wf::signal_data_t*)
+        reload_config = [=] (wf::signal_data_t *data)
         {
+            if (!wf::config_section_changed(data, "command"))
+                return;
+
             clear_bindings();
             setup_bindings_from_config(wf::get_core().config);
         };
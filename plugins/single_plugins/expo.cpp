@@ -144,7 +144,7 @@ class wayfire_expo : public wf::plugin_interface_t
         calculate_zoom(true);
 
         output->render->set_renderer(renderer);
-        output->render->set_redraw_always();
+        set_redraw_always(true);
 
         return true;
     }
@@ -155,6 +155,7 @@ class wayfire_expo : public wf::plugin_interface_t
 
         zoom_animation.start();
         output->workspace->set_workspace({target_vx, target_vy});
+        set_redraw_always(true);
 
         calculate_zoom(false);
         update_zoom();
@@ -354,14 +355,64 @@ class wayfire_expo : public wf::plugin_interface_t
               delimiter_offset;
     } render_params;
 
-    void update_streams()
+    /* Whether we have requested constant redraw from the render manager. It
+     * is needed only while zooming, otherwise damage drives the repaints */
+    bool redraw_always_set = false;
+    void set_redraw_always(bool always)
+    {
+        if (always != redraw_always_set)
+            output->render->set_redraw_always(always);
+        redraw_always_set = always;
+    }
+
+    /* Get the workspace's geometry in GL coordinates after applying the
+     * scale+translate part of the scene transform. Output rotation doesn't
+     * change whether a workspace is visible, so we ignore it here. */
+    gl_geometry get_workspace_projection(int i, int j, float hspacing,
+        float vspacing)
+    {
+        auto cws = output->workspace->get_current_workspace();
+
+        float x1 = -1 + hspacing + (i - cws.x) * 2.0f;
+        float x2 =  1 - hspacing + (i - cws.x) * 2.0f;
+        float y1 =  1 - vspacing + (cws.y - j) * 2.0f;
+        float y2 = -1 + vspacing + (cws.y - j) * 2.0f;
+
+        return {
+            x1 * render_params.scale_x + render_params.off_x,
+            y1 * render_params.scale_y + render_params.off_y,
+            x2 * render_params.scale_x + render_params.off_x,
+            y2 * render_params.scale_y + render_params.off_y,
+        };
+    }
+
+    bool is_workspace_visible(const gl_geometry& g)
+    {
+        return g.x1 < 1 && g.x2 > -1 && g.y2 < 1 && g.y1 > -1;
+    }
+
+    /* Update the streams of the visible workspaces. The render manager
+     * repaints only the damaged parts of each stream.
+     *
+     * Streams of workspaces which are zoomed or scrolled out of view are
+     * stopped, because they would lose the damage for the frames they
+     * weren't updated. They are restarted with a full repaint once they
+     * become visible again. */
+    void update_streams(float hspacing, float vspacing)
     {
         auto wsize = output->workspace->get_workspace_grid_size();
         for(int j = 0; j < wsize.height; j++)
         {
             for(int i = 0; i < wsize.width; i++)
             {
-                if (!streams[i][j].running)
+                auto projection = get_workspace_projection(i, j,
+                    hspacing, vspacing);
+
+                if (!is_workspace_visible(projection))
+                {
+                    if (streams[i][j].running)
+                        output->render->workspace_stream_stop(streams[i][j]);
+                } else if (!streams[i][j].running)
                 {
                     output->render->workspace_stream_start(streams[i][j]);
                 } else
@@ -380,37 +431,42 @@ class wayfire_expo : public wf::plugin_interface_t
      * The scale+translate part is calculated in zoom_target */
     void render(const wf_framebuffer &fb)
     {
-        update_streams();
-
         auto wsize = output->workspace->get_workspace_grid_size();
         auto cws = output->workspace->get_current_workspace();
         auto screen_size = output->get_screen_size();
 
+        /* Space between adjacent workspaces */
+        float hspacing = 1.0 * render_params.delimiter_offset / screen_size.width;
+        float vspacing = 1.0 * render_params.delimiter_offset / screen_size.height;
+
+        update_streams(hspacing, vspacing);
+        if (fb.wl_transform & 1)
+            std::swap(hspacing, vspacing);
+
         auto translate = glm::translate(glm::mat4(1.0), glm::vec3(render_params.off_x, render_params.off_y, 0));
         auto scale     = glm::scale(glm::mat4(1.0), glm::vec3(render_params.scale_x, render_params.scale_y, 1));
         auto scene_transform = fb.transform * translate * scale; // scale+translate part
+        auto inverse_rotation = glm::inverse(fb.transform);
 
         OpenGL::render_begin(fb);
         OpenGL::clear(background_color->as_cached_color());
         fb.scissor(fb.framebuffer_box_from_geometry_box(fb.geometry));
 
-        /* Space between adjacent workspaces */
-        float hspacing = 1.0 * render_params.delimiter_offset / screen_size.width;
-        float vspacing = 1.0 * render_params.delimiter_offset / screen_size.height;
-        if (fb.wl_transform & 1)
-            std::swap(hspacing, vspacing);
+        /* First, center each workspace on the output, taking spacing into account */
+        gl_geometry out_geometry = {
+            .x1 = -1 + hspacing,
+            .y1 = 1 - vspacing,
+            .x2 = 1 - hspacing,
+            .y2 = -1 + vspacing,
+        };
 
         for(int j = 0; j < wsize.height; j++)
         {
             for(int i = 0; i < wsize.width; i++)
             {
-                /* First, center each workspace on the output, taking spacing into account */
-                gl_geometry out_geometry = {
-                    .x1 = -1 + hspacing,
-                    .y1 = 1 - vspacing,
-                    .x2 = 1 - hspacing,
-                    .y2 = -1 + vspacing,
-                };
+                /* Workspaces out of view have no up-to-date contents */
+                if (!streams[i][j].running)
+                    continue;
 
                 /* Then, calculate translation matrix so that the workspace gets
                  * in its correct position relative to the focused workspace */
@@ -420,7 +476,7 @@ class wayfire_expo : public wf::plugin_interface_t
                 auto workspace_transform = scene_transform * translation;
 
                 /* Undo rotation of the workspace */
-                workspace_transform = workspace_transform * glm::inverse(fb.transform);
+                workspace_transform = workspace_transform * inverse_rotation;
 
                 OpenGL::render_transformed_texture(streams[i][j].buffer.tex,
                     out_geometry, {}, workspace_transform);
@@ -492,6 +548,10 @@ class wayfire_expo : public wf::plugin_interface_t
 
         if (!zoom_animation.running() && !state.zoom_in)
             finalize_and_exit();
+
+        /* Zoom-in has finished, from now on only damage triggers repaints */
+        if (!zoom_animation.running() && state.zoom_in)
+            set_redraw_always(false);
     }
 
     void finalize_and_exit()
@@ -508,7 +568,7 @@ class wayfire_expo : public wf::plugin_interface_t
         }
 
         output->render->set_renderer(nullptr);
-        output->render->set_redraw_always(false);
+        set_redraw_always(false);
     }
 
     void fini()
@@ -2,6 +2,7 @@
 #include <output.hpp>
 #include <opengl.hpp>
 #include <debug.hpp>
+#include <util.hpp>
 #include <render-manager.hpp>
 
 static const char* vertex_shader =
@@ -40,7 +41,7 @@ class wayfire_invert_screen : public wf::plugin_interface_t
     activator_callback toggle_cb;
 
     bool active = false;
-    GLuint program, posID, uvID;
+    GLuint program = -1, posID, uvID;
 
     public:
 
@@ -79,7 +80,10 @@ class wayfire_invert_screen : public wf::plugin_interface_t
                 output->render->rem_post(&hook);
             } else
             {
-                output->render->add_post(&hook);
+                if (program == (GLuint)-1)
+                    load_program();
+
+                output->render->add_post(&hook, true);
             }
 
             active = !active;
@@ -87,7 +91,6 @@ class wayfire_invert_screen : public wf::plugin_interface_t
             return true;
         };
 
-        load_program();
         output->add_activator(toggle_key, &toggle_cb);
     }
 
@@ -121,7 +124,11 @@ class wayfire_invert_screen : public wf::plugin_interface_t
         GL_CALL(glEnableVertexAttribArray(uvID));
 
         GL_CALL(glDisable(GL_BLEND));
-        GL_CALL(glDrawArrays (GL_TRIANGLE_FAN, 0, 4));
+        for (const auto& box : output->render->get_post_damage())
+        {
+            destination.scissor(wlr_box_from_pixman_box(box));
+            GL_CALL(glDrawArrays (GL_TRIANGLE_FAN, 0, 4));
+        }
 
         GL_CALL(glEnable(GL_BLEND));
 
@@ -138,9 +145,12 @@ class wayfire_invert_screen : public wf::plugin_interface_t
         if (active)
             output->render->rem_post(&hook);
 
-        OpenGL::render_begin();
-        GL_CALL(glDeleteProgram(program));
-        OpenGL::render_end();
+        if (program != (GLuint)-1)
+        {
+            OpenGL::render_begin();
+            GL_CALL(glDeleteProgram(program));
+            OpenGL::render_end();
+        }
 
         output->rem_binding(&toggle_cb);
     }
@@ -0,0 +1,305 @@
+#include <plugin.hpp>
+#include <output.hpp>
+#include <opengl.hpp>
+#include <debug.hpp>
+#include <util.hpp>
+#include <render-manager.hpp>
+#include <plugin-profiler.hpp>
+#include <gpu-profiler.hpp>
+
+#include <cairo.h>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+/* Shows the CPU and GPU time each plugin and render pass spend per frame in a
+ * corner of the output */
+class wayfire_profiler_overlay : public wf::plugin_interface_t
+{
+    activator_callback toggle_cb;
+    wf::effect_hook_t update_hook, render_hook;
+
+    bool active = false;
+
+    /* The text which is currently shown, and the rendered text which still
+     * needs to be uploaded */
+    std::string text;
+    cairo_surface_t *surface = nullptr;
+
+    GLuint tex = -1;
+    /* Where the overlay is, in output-local coordinates */
+    wlr_box box = {0, 0, 0, 0};
+
+    static constexpr int margin = 10;
+    static constexpr int padding = 6;
+    static constexpr double font_size = 14;
+    static constexpr int max_plugins = 10;
+    static constexpr int max_passes = 5;
+
+  public:
+    void init(wayfire_config *config)
+    {
+        auto section = config->get_section("profiler");
+        auto toggle_key = section->get_option("toggle", "<super> <alt> KEY_P");
+
+        grab_interface->name = "profiler";
+        grab_interface->capabilities = 0;
+
+        /* Called after each frame, when the profiler might have finished a
+         * report period */
+        update_hook = [=] () { update_text(); };
+        render_hook = [=] () { render(); };
+
+        toggle_cb = [=] (wf_activator_source, uint32_t) {
+            if (active)
+                hide();
+            else
+                show();
+
+            return true;
+        };
+
+        output->add_activator(toggle_key, &toggle_cb);
+    }
+
+    void show()
+    {
+        active = true;
+        wf::plugin_profiler::set_enabled(true);
+        wf::gpu_profiler::set_enabled(true);
+        output->render->add_effect(&update_hook, wf::OUTPUT_EFFECT_POST);
+        output->render->add_effect(&render_hook, wf::OUTPUT_EFFECT_OVERLAY);
+        update_text();
+    }
+
+    void hide()
+    {
+        active = false;
+        wf::plugin_profiler::set_enabled(false);
+        wf::gpu_profiler::set_enabled(false);
+        output->render->rem_effect(&update_hook);
+        output->render->rem_effect(&render_hook);
+        output->render->damage(box);
+
+        text.clear();
+        box = {0, 0, 0, 0};
+    }
+
+    /* GPU times are -1 when the driver can't measure them */
+    static std::string format_gpu_ms(double ms)
+    {
+        char buf[32];
+        if (ms < 0)
+            snprintf(buf, sizeof(buf), "%8s", "-");
+        else
+            snprintf(buf, sizeof(buf), "%6.2fms", ms);
+
+        return buf;
+    }
+
+    std::vector<std::string> format_costs()
+    {
+        std::vector<std::string> lines;
+        lines.push_back("plugin CPU time per frame, avg / max, GPU avg");
+
+        auto costs = wf::plugin_profiler::get_plugin_costs();
+        for (size_t i = 0; i < costs.size() && (int)i < max_plugins; i++)
+        {
+            char buf[128];
+            snprintf(buf, sizeof(buf), "%-16.16s %6.2fms / %6.2fms %s",
+                costs[i].name.c_str(), costs[i].cpu_avg_ms, costs[i].cpu_max_ms,
+                format_gpu_ms(costs[i].gpu_avg_ms).c_str());
+            lines.push_back(buf);
+        }
+
+        if (costs.empty())
+        {
+            lines.push_back("waiting for frames...");
+            return lines;
+        }
+
+        lines.push_back("");
+        lines.push_back("GPU time per frame: " +
+            format_gpu_ms(wf::gpu_profiler::get_frame_gpu_ms()));
+        if (!wf::gpu_profiler::is_supported())
+            lines.push_back("(timer queries are not supported)");
+
+        lines.push_back("render pass      calls   CPU avg  GPU avg");
+        auto passes = wf::gpu_profiler::get_pass_times();
+        for (size_t i = 0; i < passes.size() && (int)i < max_passes; i++)
+        {
+            char buf[128];
+            snprintf(buf, sizeof(buf), "%-16.16s %5.1f  %6.2fms %s",
+                passes[i].name.c_str(), passes[i].calls, passes[i].cpu_avg_ms,
+                format_gpu_ms(passes[i].gpu_avg_ms).c_str());
+            lines.push_back(buf);
+        }
+
+        return lines;
+    }
+
+    void update_text()
+    {
+        auto lines = format_costs();
+
+        std::string new_text;
+        for (auto& line : lines)
+            new_text += line + "\n";
+
+        if (new_text == text)
+            return;
+
+        text = new_text;
+
+        /* Render the text at the output's scale */
+        double scale = output->handle->scale;
+        auto measure = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+        auto cr = cairo_create(measure);
+        cairo_select_font_face(cr, "monospace",
+            CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+        cairo_set_font_size(cr, font_size * scale);
+
+        cairo_font_extents_t font_ext;
+        cairo_font_extents(cr, &font_ext);
+
+        double width = 0;
+        for (auto& line : lines)
+        {
+            cairo_text_extents_t ext;
+            cairo_text_extents(cr, line.c_str(), &ext);
+            width = std::max(width, ext.x_advance);
+        }
+
+        cairo_destroy(cr);
+        cairo_surface_destroy(measure);
+
+        int pad = padding * scale;
+        int surface_width = std::ceil(width) + 2 * pad;
+        int surface_height = std::ceil(font_ext.height * lines.size()) + 2 * pad;
+
+        if (surface)
+            cairo_surface_destroy(surface);
+
+        surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+            surface_width, surface_height);
+        cr = cairo_create(surface);
+
+        cairo_set_source_rgba(cr, 0, 0, 0, 0.7);
+        cairo_paint(cr);
+
+        cairo_select_font_face(cr, "monospace",
+            CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+        cairo_set_font_size(cr, font_size * scale);
+        cairo_set_source_rgba(cr, 1, 1, 1, 1);
+
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            cairo_move_to(cr, pad, pad + font_ext.ascent + i * font_ext.height);
+            cairo_show_text(cr, lines[i].c_str());
+        }
+
+        cairo_destroy(cr);
+        cairo_surface_flush(surface);
+
+        /* Damage both the old and the new area of the overlay */
+        output->render->damage(box);
+        box = {margin, margin, (int)std::ceil(surface_width / scale),
+            (int)std::ceil(surface_height / scale)};
+        output->render->damage(box);
+    }
+
+    void upload_text()
+    {
+        if (tex == (GLuint)-1)
+        {
+            GL_CALL(glGenTextures(1, &tex));
+            GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+            GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+            GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+            GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+            GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        }
+
+        /* cairo stores premultiplied BGRA pixels, and GLES can't upload
+         * BGRA without an extension, so swap the channels on the CPU */
+        int width = cairo_image_surface_get_width(surface);
+        int height = cairo_image_surface_get_height(surface);
+        int stride = cairo_image_surface_get_stride(surface);
+        auto data = cairo_image_surface_get_data(surface);
+
+        std::vector<uint8_t> pixels(width * height * 4);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                auto src = data + y * stride + x * 4;
+                auto dst = pixels.data() + (y * width + x) * 4;
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
+                dst[3] = src[3];
+            }
+        }
+
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+        GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height,
+                0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data()));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+
+        cairo_surface_destroy(surface);
+        surface = nullptr;
+    }
+
+    void render()
+    {
+        auto fb = output->render->get_target_framebuffer();
+
+        /* Repaint only the damaged part of the overlay, otherwise the
+         * translucent background would be blended onto itself */
+        wf_region damage = output->render->get_scheduled_damage();
+        damage &= fb.damage_box_from_geometry_box(box);
+        if (damage.empty())
+            return;
+
+        OpenGL::render_begin(fb);
+        if (surface)
+            upload_text();
+
+        gl_geometry geometry = {
+            1.0f * box.x + fb.geometry.x, 1.0f * box.y + fb.geometry.y,
+            1.0f * box.x + fb.geometry.x + box.width,
+            1.0f * box.y + fb.geometry.y + box.height,
+        };
+
+        for (const auto& rect : damage)
+        {
+            fb.scissor(fb.framebuffer_box_from_damage_box(
+                    wlr_box_from_pixman_box(rect)));
+            OpenGL::render_transformed_texture(tex, geometry, {},
+                fb.get_orthographic_projection(), glm::vec4(1.0),
+                TEXTURE_TRANSFORM_INVERT_Y);
+        }
+
+        OpenGL::render_end();
+    }
+
+    void fini()
+    {
+        if (active)
+            hide();
+
+        if (surface)
+            cairo_surface_destroy(surface);
+
+        if (tex != (GLuint)-1)
+        {
+            OpenGL::render_begin();
+            GL_CALL(glDeleteTextures(1, &tex));
+            OpenGL::render_end();
+        }
+
+        output->rem_binding(&toggle_cb);
+    }
+};
+
+DECLARE_WAYFIRE_PLUGIN(wayfire_profiler_overlay);
@@ -16,6 +16,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <algorithm>
+#include <cmath>
 #include <exception>
 #include <set>
 
@@ -24,6 +25,102 @@ constexpr const char* switcher_transformer_background = "switcher-3d";
 
 constexpr float background_dim_factor = 0.6;
 
+/* The 3D transformer used for the views in the carousel.
+ *
+ * Views in the switcher are displayed scaled down, so sampling the full-size
+ * view contents every frame is wasteful. Instead, we keep a downscaled
+ * thumbnail of the view, which is refreshed only when the view gets damaged.
+ * Static views are then drawn with a single small texture. */
+class SwitcherThumbnailTransformer : public wf_3D_view
+{
+    wf_framebuffer_base thumbnail;
+    /* Intermediate buffers for refresh_thumbnail() */
+    wf_framebuffer_base steps[2];
+    bool thumbnail_dirty = true;
+
+    wf::signal_callback_t view_damaged = [=] (wf::signal_data_t*)
+    {
+        thumbnail_dirty = true;
+    };
+
+    void downscale(uint32_t src_tex, wf_framebuffer_base& target,
+        int width, int height)
+    {
+        OpenGL::render_begin();
+        target.allocate(width, height);
+        OpenGL::render_end();
+
+        OpenGL::render_begin(target);
+        OpenGL::clear({0, 0, 0, 0});
+        OpenGL::render_transformed_texture(src_tex, {-1, 1, 1, -1}, {});
+        OpenGL::render_end();
+    }
+
+    /* Downscale the view in steps of at most 2x. With GL_LINEAR, each step
+     * averages all source texels, so there is no aliasing like with a single
+     * big minification. Mipmaps would do the same, but GLES2 can't generate
+     * them for NPOT textures. */
+    void refresh_thumbnail(uint32_t src_tex, int src_width, int src_height,
+        int width, int height)
+    {
+        int step = 0;
+        while (src_width > 2 * width || src_height > 2 * height)
+        {
+            src_width = std::max(width, (src_width + 1) / 2);
+            src_height = std::max(height, (src_height + 1) / 2);
+
+            downscale(src_tex, steps[step], src_width, src_height);
+            src_tex = steps[step].tex;
+            step ^= 1;
+        }
+
+        downscale(src_tex, thumbnail, width, height);
+        thumbnail_dirty = false;
+    }
+
+  public:
+    /* The largest scale at which the view is shown in the current animation,
+     * the thumbnail isn't used when it is 1 or more */
+    float thumbnail_scale = 1.0;
+
+    SwitcherThumbnailTransformer(wayfire_view view) : wf_3D_view(view)
+    {
+        view->connect_signal("damaged-region", &view_damaged);
+    }
+
+    ~SwitcherThumbnailTransformer()
+    {
+        view->disconnect_signal("damaged-region", &view_damaged);
+
+        OpenGL::render_begin();
+        thumbnail.release();
+        steps[0].release();
+        steps[1].release();
+        OpenGL::render_end();
+    }
+
+    void render_with_damage(uint32_t src_tex, wlr_box src_box,
+        const wf_region& damage, const wf_framebuffer& target_fb) override
+    {
+        float scale = thumbnail_scale * target_fb.scale;
+        int width = std::ceil(src_box.width * scale);
+        int height = std::ceil(src_box.height * scale);
+
+        /* The view isn't scaled down, a thumbnail wouldn't help */
+        if (scale >= 1.0 || width <= 0 || height <= 0)
+            return wf_3D_view::render_with_damage(src_tex, src_box, damage, target_fb);
+
+        if (thumbnail_dirty || width != thumbnail.viewport_width ||
+            height != thumbnail.viewport_height)
+        {
+            refresh_thumbnail(src_tex, std::ceil(src_box.width * target_fb.scale),
+                std::ceil(src_box.height * target_fb.scale), width, height);
+        }
+
+        wf_3D_view::render_with_damage(thumbnail.tex, src_box, damage, target_fb);
+    }
+};
+
 struct SwitcherPaintAttribs
 {
     wf_transition scale_x{1, 1}, scale_y{1, 1};
@@ -565,7 +662,8 @@ class WayfireSwitcher : public wf::plugin_interface_t
          * the whole output */
         if (!view->get_transformer(switcher_transformer))
         {
-            view->add_transformer(std::make_unique<wf_3D_view> (view),
+            view->add_transformer(
+                std::make_unique<SwitcherThumbnailTransformer> (view),
                 switcher_transformer);
         }
 
@@ -594,6 +692,17 @@ class WayfireSwitcher : public wf::plugin_interface_t
             glm::mat4(1.0), (float)duration.progress(sv.attribs.rotation),
             {0.0, 1.0, 0.0});
 
+        /* Size the thumbnail for the largest scale of the animation, so that
+         * it doesn't need to be refreshed each frame and the view isn't drawn
+         * larger than its thumbnail */
+        auto thumbnail = dynamic_cast<SwitcherThumbnailTransformer*> (transform);
+        if (thumbnail)
+        {
+            thumbnail->thumbnail_scale = std::max({
+                sv.attribs.scale_x.start, sv.attribs.scale_x.end,
+                sv.attribs.scale_y.start, sv.attribs.scale_y.end});
+        }
+
         transform->color[3] = duration.progress(sv.attribs.alpha);
         sv.view->render_transformed(output->render->get_target_framebuffer(),
             output->render->get_target_framebuffer().get_damage_region());
@@ -5,6 +5,8 @@
 #include <cstdio>
 #include <signal-definitions.hpp>
 #include <assert.h>
+#include <algorithm>
+#include <unordered_map>
 #include <map>
 
 using std::string;
@@ -51,46 +53,28 @@ static bool ends_with(string x, string y)
 }
 
 
-class wayfire_window_rules : public wf::plugin_interface_t
+/* The attribute of the view a rule is matched against */
+enum rule_field
 {
-    using verification_func = std::function<bool(wayfire_view, std::string)>;
+    RULE_FIELD_TITLE  = 0,
+    RULE_FIELD_APP_ID = 1,
+};
 
+class wayfire_window_rules : public wf::plugin_interface_t
+{
     struct verificator
     {
-        verification_func func;
+        rule_field field;
+        bool contains;
         std::string atom;
     };
 
     std::vector<verificator> verficators =
     {
-        {  [] (wayfire_view view, std::string match) -> bool
-            {
-                auto title = view->get_title();
-                return title.find(match) != std::string::npos;
-            },
-            "title contains"
-        },
-        { [] (wayfire_view view, std::string match) -> bool
-            {
-                auto title = view->get_title();
-                return title == match;
-            },
-            "title"
-        },
-        {  [] (wayfire_view view, std::string match) -> bool
-            {
-                auto app_id = view->get_app_id();
-                return app_id.find(match) != std::string::npos;
-            },
-            "app-id contains"
-        },
-        {  [] (wayfire_view view, std::string match) -> bool
-            {
-                auto app_id = view->get_app_id();
-                return app_id == match;
-            },
-            "app-id"
-        },
+        {RULE_FIELD_TITLE, true, "title contains"},
+        {RULE_FIELD_TITLE, false, "title"},
+        {RULE_FIELD_APP_ID, true, "app-id contains"},
+        {RULE_FIELD_APP_ID, false, "app-id"},
     };
 
     std::vector<std::string> events = {
@@ -99,18 +83,13 @@ class wayfire_window_rules : public wf::plugin_interface_t
 
     using action_func = std::function<void(wayfire_view view)>;
 
-    struct lambda_executor
-    {
-        verification_func verify;
-        std::string verification_string;
-        action_func action;
-    };
-
-    using rule_func = std::function<void(wayfire_view)>;
     struct rule
     {
         std::string signal;
-        std::function<void(wayfire_view)> func;
+        rule_field field;
+        bool contains;
+        std::string match;
+        action_func action;
     };
 
     rule parse_add_rule(std::string rule)
@@ -143,23 +122,24 @@ class wayfire_window_rules : public wf::plugin_interface_t
             }
         }
 
-        lambda_executor exec;
-        exec.verify = nullptr;
-        exec.action = nullptr;
+        action_func exec_action = nullptr;
+        bool has_predicate = false;
 
         for (const auto& pred : verficators)
         {
             if (starts_with(predicate, pred.atom))
             {
-                exec.verify = pred.func;
-                exec.verification_string =
+                has_predicate = true;
+                result.field = pred.field;
+                result.contains = pred.contains;
+                result.match =
                     trim(predicate.substr(pred.atom.length(),
                                           predicate.length() - pred.atom.length()));
                 break;
             }
         }
 
-        if (!exec.verify || !event.length())
+        if (!has_predicate || !event.length())
             return result;
 
         if (starts_with(action, "move"))
@@ -170,7 +150,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
             if (t != 2)
                 return result;
 
-            exec.action = [x,y] (wayfire_view view) {
+            exec_action = [x,y] (wayfire_view view) {
                 auto og = view->get_output()->get_relative_geometry();
                 view->move(og.x + x, og.y + y);
             };
@@ -182,7 +162,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
             if (t != 2 || w <= 0 || h <= 0)
                 return result;
 
-            exec.action = [w,h] (wayfire_view view) mutable {
+            exec_action = [w,h] (wayfire_view view) mutable {
                 auto screen_size = view->get_output()->get_screen_size();
                 if (w > 100000)
                     w = screen_size.width;
@@ -192,7 +172,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
             };
         } else if (ends_with(action, "set maximized"))
         {
-            exec.action = [action] (wayfire_view view)
+            exec_action = [action] (wayfire_view view)
             {
                 uint32_t edges =
                     starts_with(action, "set") ? wf::TILED_EDGES_ALL : 0;
@@ -202,7 +182,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
 
         else if (ends_with(action, "set fullscreen"))
         {
-            exec.action = [action] (wayfire_view view)
+            exec_action = [action] (wayfire_view view)
             {
                 view_fullscreen_signal data;
                 data.view = view;
@@ -212,22 +192,78 @@ class wayfire_window_rules : public wf::plugin_interface_t
         }
 
 
-        if (!exec.action)
+        if (!exec_action)
             return result;
 
         result.signal = event;
-        result.func = [exec] (wayfire_view view)
+        result.action = exec_action;
+
+        return result;
+    }
+
+    /* Rules of a single event, indexed so that only the rules which can
+     * match a view need to be checked. Exact matches are looked up by their
+     * text, and only substring rules are checked one by one. */
+    struct rule_index_t
+    {
+        std::unordered_map<std::string, std::vector<size_t>> exact[2];
+        std::vector<size_t> contains[2];
+    };
+
+    std::vector<rule> rules;
+    std::map<std::string, rule_index_t> rules_index;
+
+    void add_rule(rule&& r)
+    {
+        size_t id = rules.size();
+        auto& index = rules_index[r.signal];
+        if (r.contains) {
+            index.contains[r.field].push_back(id);
+        } else {
+            index.exact[r.field][r.match].push_back(id);
+        }
+
+        rules.push_back(std::move(r));
+    }
+
+    /* Find the rules for the given event which match the view,
+     * in the order they were specified in the config file */
+    std::vector<size_t> find_matching_rules(const rule_index_t& index,
+        const std::string fields[2])
+    {
+        std::vector<size_t> result;
+        for (int field : {RULE_FIELD_TITLE, RULE_FIELD_APP_ID})
         {
-            if (exec.verify(view, exec.verification_string))
-                exec.action(view);
-        };
+            auto it = index.exact[field].find(fields[field]);
+            if (it != index.exact[field].end())
+                result.insert(result.end(), it->second.begin(), it->second.end());
 
+            for (auto id : index.contains[field])
+            {
+                if (fields[field].find(rules[id].match) != std::string::npos)
+                    result.push_back(id);
+            }
+        }
+
+        std::sort(result.begin(), result.end());
         return result;
     }
 
-    wf::signal_callback_t created, maximized, fullscreened;
+    void apply_rules(std::string event, wayfire_view view)
+    {
+        auto it = rules_index.find(event);
+        if (it == rules_index.end())
+            return;
 
-    std::map<std::string, std::vector<rule_func>> rules_list;
+        std::string fields[2];
+        fields[RULE_FIELD_TITLE] = view->get_title();
+        fields[RULE_FIELD_APP_ID] = view->get_app_id();
+
+        for (auto id : find_matching_rules(it->second, fields))
+            rules[id].action(view);
+    }
+
+    wf::signal_callback_t created, maximized, fullscreened;
 
     public:
     void init(wayfire_config *config)
@@ -236,13 +272,13 @@ class wayfire_window_rules : public wf::plugin_interface_t
         for (auto opt : section->options)
         {
             auto rule = parse_add_rule(opt->as_string());
-            rules_list[rule.signal].push_back(rule.func);
+            if (rule.action)
+                add_rule(std::move(rule));
         }
 
         created = [=] (wf::signal_data_t *data)
         {
-            for (const auto& rule : rules_list["created"])
-                rule(get_signaled_view(data));
+            apply_rules("created", get_signaled_view(data));
         };
         output->connect_signal("map-view", &created);
 
@@ -254,8 +290,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
             if (conv->edges != wf::TILED_EDGES_ALL)
                 return;
 
-            for (const auto& rule : rules_list["maximized"])
-                rule(conv->view);
+            apply_rules("maximized", conv->view);
         };
         output->connect_signal("view-maximized", &maximized);
 
@@ -267,8 +302,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
             if (!conv->state || conv->carried_out)
                 return;
 
-            for (const auto& rule : rules_list["fullscreened"])
-                rule(conv->view);
+            apply_rules("fullscreened", conv->view);
             conv->carried_out = true;
         };
         output->connect_signal("view-fullscreen", &fullscreened);
@@ -0,0 +1,98 @@
+#ifndef WF_GPU_PROFILER_HPP
+#define WF_GPU_PROFILER_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace wf
+{
+/**
+ * Measures how long the GPU takes to execute render passes, using
+ * GL_EXT_disjoint_timer_query, together with the CPU time spent issuing them.
+ * Comparing both shows whether frames are CPU- or GPU-bound.
+ *
+ * Timer queries don't stall the pipeline: their results are read back a few
+ * frames later, when the GPU has made them available. Results of frames
+ * during which the GPU timer was disjoint (e.g the GPU changed its clock
+ * frequency) are dropped.
+ *
+ * GPU times are measured only for passes which run while an output is being
+ * repainted. If the driver supports timestamp queries, passes may be nested
+ * and the GPU time of plugins is reported by the plugin profiler too.
+ * Otherwise, only passes which aren't nested in other passes get a GPU time.
+ */
+namespace gpu_profiler
+{
+struct pass_time_t
+{
+    /* The name of the pass, as given to scope_t */
+    std::string name;
+    /* Average number of times the pass ran per frame */
+    double calls = 0;
+    /* Average CPU and GPU time per frame in milliseconds, including the
+     * passes nested in it. gpu_avg_ms is -1 if not available */
+    double cpu_avg_ms = 0;
+    double gpu_avg_ms = -1;
+};
+
+/**
+ * Start collecting statistics. Call set_enabled(false) once for each
+ * set_enabled(true). Also enabled with --frame-stats.
+ */
+void set_enabled(bool enabled);
+bool is_enabled();
+
+/** @return Whether the driver supports timer queries */
+bool is_supported();
+
+/**
+ * Measures the render pass issued between the creation and the destruction
+ * of the scope. The name must be a string literal. Must be created and
+ * destroyed while the same GL context is current, for ex. between
+ * OpenGL::render_begin() and render_end() or inside render hooks.
+ */
+class scope_t
+{
+  public:
+    scope_t(const char *name);
+    ~scope_t();
+
+    scope_t(const scope_t&) = delete;
+    scope_t& operator = (const scope_t&) = delete;
+
+  private:
+    const char *name;
+    int64_t cpu_start_us = -1;
+    /* The query which marks the start of the pass, 0 if not measured */
+    uint32_t query = 0;
+};
+
+/**
+ * @return The times of the passes during the last complete report period
+ * of one second, most expensive on the GPU first. Frames of all outputs are
+ * counted.
+ */
+std::vector<pass_time_t> get_pass_times();
+
+/** @return The average GPU time of whole frames in milliseconds during the
+ * last report period, or -1 if not available */
+double get_frame_gpu_ms();
+
+/** @return The average GPU time per frame in milliseconds of the given
+ * plugin during the last report period, or -1 if not available */
+double get_plugin_gpu_ms(const std::string& plugin);
+
+/* Used by core to indicate the start and the end of a repaint, with the
+ * output's GL context current */
+void begin_frame();
+void end_frame();
+
+/* Used by the plugin profiler to indicate that the running plugin changes
+ * and that the GPU work since the last change was issued by the given
+ * plugin, empty for core */
+void plugin_switched(const std::string& previous);
+}
+}
+
+#endif /* end of include guard: WF_GPU_PROFILER_HPP */
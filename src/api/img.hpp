@@ -4,17 +4,103 @@
 #include "debug.hpp"
 #include <GLES2/gl2.h>
 #include <string>
+#include <vector>
+#include <functional>
+#include <memory>
 
 namespace image_io
 {
+    /* A decoded image, 8 bits per channel, rows ordered top to bottom */
+    struct image_t
+    {
+        int width = 0, height = 0;
+        /* GL_RGB or GL_RGBA */
+        GLenum format = GL_RGBA;
+        std::vector<uint8_t> pixels;
+    };
+
     /* Load the image from the given file, binding it to the given GL texture target
      * Bind the texture before you call this function
      * Guaranteed: doesn't change any GL state except pixel packing */
     bool load_from_file(std::string name, GLuint target);
 
+    /* Called on the main loop with the decoded image, or with nullptr if the
+     * image couldn't be loaded. The image is valid only during the callback,
+     * its memory is reused for the next images. */
+    using decode_callback_t = std::function<void(const image_t *image)>;
+
+    /* Decode the image from the given file on a worker thread, so that large
+     * images don't block the compositor.
+     *
+     * @return An id which can be passed to cancel_decode(). The callback is
+     *         never called synchronously. */
+    uint32_t decode_async(std::string name, decode_callback_t callback);
+
+    /* Make sure the callback of the given decode request won't be called.
+     * Must be called if the callback's owner is destroyed before the image is
+     * ready. No-op if the request has already completed. */
+    void cancel_decode(uint32_t id);
+
+    /* Upload a decoded image to the given GL texture target.
+     * Same guarantees as load_from_file() */
+    void upload(const image_t& image, GLuint target);
+
+    /* Upload a single opaque black pixel to the given GL texture target, to be
+     * used until the real image has been decoded.
+     * Same guarantees as load_from_file() */
+    void upload_placeholder(GLuint target);
+
+    /* A texture loaded from an image file with get_texture() */
+    struct texture_t
+    {
+        /* GL_TEXTURE_2D, or GL_TEXTURE_CUBE_MAP if the image is used for
+         * all faces of a cubemap */
+        GLenum target;
+        /* Contains a single black pixel until the image has been decoded */
+        GLuint tex = -1;
+        bool ready = false;
+        /* The image couldn't be loaded, tex is invalid */
+        bool failed = false;
+
+        /* Used internally, the pending decode_async() request */
+        uint32_t decode_request = 0;
+
+        texture_t() = default;
+        texture_t(const texture_t&) = delete;
+        texture_t& operator = (const texture_t&) = delete;
+        ~texture_t();
+    };
+
+    /* Get a texture with the image from the given file, using linear filtering
+     * and clamping to the edges. The image is decoded asynchronously.
+     *
+     * Textures are cached by path, target and modification time of the file,
+     * so all outputs and plugins which use the same image share a single copy,
+     * which is decoded and uploaded only once. The texture is freed when the
+     * last reference to it is dropped. */
+    std::shared_ptr<texture_t> get_texture(std::string name, GLenum target);
+
     /* Function that saves the given pixels(in rgba format) to a (currently) png file */
     void write_to_file(std::string name, uint8_t *pixels, int w, int h, std::string type);
 
+    /* Called on the main loop when an asynchronous write has finished */
+    using write_callback_t = std::function<void(bool success)>;
+
+    /* Same as write_to_file(), but the image is encoded and written on a
+     * worker thread. The callback is never called synchronously. */
+    void write_to_file_async(std::string name, std::vector<uint8_t> pixels,
+        int w, int h, std::string type, write_callback_t callback = nullptr);
+
+    /* Save the w x h pixels at the origin of the currently bound framebuffer
+     * to a file, without stalling the compositor: the pixels are copied to a
+     * pixel buffer object, which is read back on a later iteration of the
+     * main loop once the GPU is done, and then written with
+     * write_to_file_async().
+     *
+     * Must be called between OpenGL::render_begin() and render_end() */
+    void capture_to_file_async(int w, int h, std::string name,
+        std::string type, write_callback_t callback = nullptr);
+
     /* Initializes all backends, called at startup */
     void init();
 }
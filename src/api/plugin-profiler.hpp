@@ -0,0 +1,121 @@
+#ifndef WF_PLUGIN_PROFILER_HPP
+#define WF_PLUGIN_PROFILER_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wf
+{
+struct plugin_grab_interface_t;
+
+/**
+ * Accounting of the time plugins spend in effect hooks, post hooks, render
+ * hooks, signal callbacks and bindings.
+ *
+ * Each hook and callback is attributed to the plugin which was running when
+ * it was registered. Core keeps track of the running plugin while it calls
+ * plugins' init() and fini(), and while it runs their hooks, signal
+ * callbacks and bindings, so plugins don't need to do anything to be
+ * accounted for. Plugins are identified by the name of their grab interface,
+ * the costs of the instances on different outputs are added up.
+ *
+ * Time spent in a nested hook or callback of another plugin is charged only
+ * to the nested plugin.
+ */
+namespace plugin_profiler
+{
+/**
+ * Identifies a plugin instance in the profiler.
+ *
+ * Hooks, signal connections and bindings keep the handle of the plugin which
+ * registered them, and they may outlive the plugin, for ex. signal
+ * connections of core objects. Because of this, the handle doesn't keep
+ * pointing to the plugin after it is destroyed, it only remembers its name.
+ */
+class plugin_handle_t
+{
+  public:
+    plugin_handle_t(plugin_grab_interface_t *plugin);
+
+    /** @return The name of the plugin's grab interface */
+    const std::string& get_name() const;
+
+  private:
+    friend void plugin_destroyed(plugin_grab_interface_t *plugin);
+
+    /* nullptr after the plugin has been destroyed */
+    plugin_grab_interface_t *plugin;
+    /* The name of the plugin, saved when it is destroyed */
+    std::string name;
+};
+
+using plugin_handle_ptr = std::shared_ptr<plugin_handle_t>;
+
+struct plugin_cost_t
+{
+    /* The name of the plugin's grab interface */
+    std::string name;
+    /* Average and maximum CPU time per frame, in milliseconds */
+    double cpu_avg_ms = 0;
+    double cpu_max_ms = 0;
+    /* Average GPU time per frame in milliseconds, -1 if the GPU profiler
+     * isn't enabled or can't measure plugins */
+    double gpu_avg_ms = -1;
+};
+
+/**
+ * Start collecting statistics. Call set_enabled(false) once for each
+ * set_enabled(true). Also enabled with --frame-stats.
+ */
+void set_enabled(bool enabled);
+bool is_enabled();
+
+/**
+ * @return The costs of the plugins during the last complete report period of
+ * one second, most expensive first. Frames painted on any output are
+ * counted, and everything a plugin did between two frames is charged to the
+ * second one.
+ */
+std::vector<plugin_cost_t> get_plugin_costs();
+
+/** @return The handle of the plugin whose code is currently running, or
+ * nullptr */
+plugin_handle_ptr get_current_plugin();
+
+/**
+ * @return The handle of the given plugin instance, created on first use.
+ * Used by core when calling the plugin's init() and fini().
+ */
+plugin_handle_ptr get_handle(plugin_grab_interface_t *plugin);
+
+/**
+ * Used by core before the grab interface of a plugin is freed. Existing
+ * handles of the plugin keep only its name afterwards.
+ */
+void plugin_destroyed(plugin_grab_interface_t *plugin);
+
+/**
+ * Indicates that the code of the given plugin runs until the scope is
+ * destroyed. Used by core when calling into plugins. No-op for nullptr.
+ */
+class scope_t
+{
+  public:
+    scope_t(const plugin_handle_ptr& plugin);
+    ~scope_t();
+
+    scope_t(const scope_t&) = delete;
+    scope_t& operator = (const scope_t&) = delete;
+
+  private:
+    bool active = false;
+    plugin_handle_ptr previous;
+};
+
+/** Used by core to indicate that a frame has been painted on some output */
+void frame_done();
+}
+}
+
+#endif /* end of include guard: WF_PLUGIN_PROFILER_HPP */
@@ -130,6 +130,10 @@ class plugin_interface_t
     /**
      * The init method is the entry of the plugin. In the init() method, the
      * plugin should register all bindings it provides, connect to signals, etc.
+     *
+     * Since a plugin instance is created for each output, heavy setup such as
+     * compiling shaders or loading textures should be deferred until the
+     * plugin is first activated, where possible.
      */
     virtual void init(wayfire_config *config) = 0;
 
@@ -167,7 +171,7 @@ class plugin_interface_t
 using wayfire_plugin_load_func = wf::plugin_interface_t* (*)();
 
 /** The version of Wayfire's API/ABI */
-constexpr uint32_t WAYFIRE_API_ABI_VERSION = 2019'10'08;
+constexpr uint32_t WAYFIRE_API_ABI_VERSION = 2026'10'19;
 
 /**
  * Each plugin must also provide a function which returns the Wayfire API/ABI
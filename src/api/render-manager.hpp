@@ -112,8 +112,12 @@ class render_manager : public wf::signal_provider_t
      * Add a new post hook.
      *
      * @param hook The hook callack
+     * @param pixel_local Whether each pixel the hook outputs depends only on
+     *        the pixel at the same position in the source, as is the case for
+     *        color filters. If all active post hooks are pixel-local, they
+     *        need to repaint only the region returned by get_post_damage().
      */
-    void add_post(post_hook_t* hook);
+    void add_post(post_hook_t* hook, bool pixel_local = false);
 
     /**
      * Remove a post hook. No-op if hook isn't active.
@@ -122,6 +126,14 @@ class render_manager : public wf::signal_provider_t
      */
     void rem_post(post_hook_t* hook);
 
+    /**
+     * @return The region which post hooks have to repaint in the current
+     * frame, in framebuffer coordinates, i.e suitable for
+     * wf_framebuffer_base::scissor(). Valid only inside post hooks. Covers
+     * the whole output if there is a post hook which isn't pixel-local.
+     */
+    const wf_region& get_post_damage() const;
+
     /**
      * @return The damaged region on the current output for the current
      * frame. Note that a larger region might actually be repainted due to
@@ -4,6 +4,9 @@
 #include "view.hpp"
 #include "output.hpp"
 
+#include <set>
+#include <string>
+
 /* signal definitions */
 /* convenience functions are provided to get some basic info from the signal */
 struct _view_signal : public wf::signal_data_t
@@ -146,6 +149,24 @@ namespace wf
         /* The event as it has arrived from wlroots */
         wlr_event_t *event;
     };
+
+    /**
+     * reload-config is emitted on core after the config file has been
+     * reloaded and at least one option has changed.
+     */
+    struct reload_config_signal : public wf::signal_data_t
+    {
+        /* The sections in which options were added, removed or changed */
+        std::set<std::string> changed_sections;
+    };
+
+    /**
+     * @return Whether the given section of the config file was changed, for
+     * the data of a reload-config signal. Signals without data are treated as
+     * if all sections have changed.
+     */
+    bool config_section_changed(wf::signal_data_t *data,
+        const std::string& section);
 }
 
 #endif
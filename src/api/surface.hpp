@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <type_traits>
 
 #include "geometry.hpp"
 
@@ -75,13 +77,63 @@ class surface_interface_t
      * surface.
      *
      * @return a list of each mapped surface in the surface tree, including the
-     * surface itself.
+     * surface itself, ordered from the topmost to the bottom-most one.
      *
-     * The surfaces should be ordered from the topmost to the bottom-most one.
+     * This is a convenience wrapper around visit_surfaces(). Prefer
+     * for_each_surface() in code which runs every frame.
      */
-    virtual std::vector<surface_iterator_t> enumerate_surfaces(
+    std::vector<surface_iterator_t> enumerate_surfaces(
         wf_point surface_origin = {0, 0});
 
+    /**
+     * Call callback(surface_interface_t*, const wf_point&) for each mapped
+     * surface in the surface tree, in the same order as enumerate_surfaces(),
+     * without building a list or allocating a std::function.
+     *
+     * @param surface_origin The coordinates of the top-left corner of the
+     * surface.
+     */
+    template<class Callback>
+    void for_each_surface(Callback&& callback, wf_point surface_origin = {0, 0})
+    {
+        visit_surfaces(&invoke_visitor<Callback>,
+            const_cast<void*> (static_cast<const void*> (&callback)),
+            surface_origin, false);
+    }
+
+    /**
+     * Same as for_each_surface(), but the surfaces are visited from the
+     * bottom-most to the topmost one, i.e in rendering order.
+     */
+    template<class Callback>
+    void for_each_surface_reverse(Callback&& callback,
+        wf_point surface_origin = {0, 0})
+    {
+        visit_surfaces(&invoke_visitor<Callback>,
+            const_cast<void*> (static_cast<const void*> (&callback)),
+            surface_origin, true);
+    }
+
+    using surface_visitor_t =
+        void (*)(void *data, surface_interface_t *surface, const wf_point& pos);
+
+    /**
+     * Walk the mapped surfaces in the surface tree and call
+     * visitor(data, surface, position) for each of them.
+     *
+     * This is the only place where the surface tree is traversed:
+     * for_each_surface(), for_each_surface_reverse() and enumerate_surfaces()
+     * are built on it, so surfaces with a custom surface tree need to override
+     * only this function.
+     *
+     * @param surface_origin The coordinates of the top-left corner of the
+     * surface.
+     * @param bottom_first Whether to visit the surfaces from the bottom-most
+     * to the topmost one, instead of from the topmost one.
+     */
+    virtual void visit_surfaces(surface_visitor_t visitor, void *data,
+        wf_point surface_origin, bool bottom_first);
+
     /**
      * @return The output the surface is currently attached to. Note this
      * doesn't necessarily mean that it is visible.
@@ -184,6 +236,15 @@ class surface_interface_t
      * accessed after calling destruct().
      */
     virtual void destruct();
+
+  private:
+    template<class Callback>
+    static void invoke_visitor(void *data, surface_interface_t *surface,
+        const wf_point& position)
+    {
+        (*static_cast<std::remove_reference_t<Callback>*> (data))(surface,
+            position);
+    }
 };
 void emit_map_state_change(wf::surface_interface_t *surface);
 }
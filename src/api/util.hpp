@@ -56,6 +56,14 @@ struct wf_region
     wf_region& operator ^= (const wlr_box& box);
     wf_region& operator ^= (const wf_region& other);
 
+    /* Combined operations for common patterns, which don't create
+     * temporary regions */
+
+    /* Set the region to the intersection of other and box, translated by
+     * delta. Equivalent to *this = (other & box) + delta */
+    void set_translated_intersection(const wf_region& other,
+        const wlr_box& box, const wf_point& delta);
+
     pixman_region32_t *to_pixman();
 
     const pixman_box32_t* begin() const;
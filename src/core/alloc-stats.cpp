@@ -0,0 +1,68 @@
+#include "alloc-stats.hpp"
+#include "config.h"
+
+#include <atomic>
+#include <cstdlib>
+
+#if defined(WAYFIRE_ALLOC_STATS) && defined(__GLIBC__)
+#define WF_COUNT_ALLOCATIONS 1
+
+namespace
+{
+    /* Constant-initialized, so it works for allocations before main() */
+    std::atomic<uint64_t> allocation_count{0};
+}
+
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+
+    /* The binary is linked with -rdynamic, so these take precedence over
+     * glibc's versions in all libraries and plugins. free() and the aligned
+     * allocation functions aren't replaced, glibc's free() works with the
+     * memory from __libc_*. */
+    void *malloc(size_t size)
+    {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        return __libc_realloc(ptr, size);
+    }
+}
+#endif
+
+namespace wf
+{
+namespace alloc_stats
+{
+bool is_available()
+{
+#ifdef WF_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t get_count()
+{
+#ifdef WF_COUNT_ALLOCATIONS
+    return allocation_count.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+}
+}
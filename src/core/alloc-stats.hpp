@@ -0,0 +1,26 @@
+#ifndef WF_ALLOC_STATS_HPP
+#define WF_ALLOC_STATS_HPP
+
+#include <cstdint>
+
+/**
+ * Counting of heap allocations, used by --frame-stats and the benchmarks.
+ *
+ * Only available when built with -Denable_benchmarks=true on glibc: malloc(),
+ * calloc() and realloc() are then interposed for the whole process, so
+ * allocations in wlroots, pixman and plugins are counted too, as well as
+ * those of other threads.
+ */
+namespace wf
+{
+namespace alloc_stats
+{
+/** Whether allocations are being counted */
+bool is_available();
+
+/** @return The number of allocations since startup, 0 if not available */
+uint64_t get_count();
+}
+}
+
+#endif /* end of include guard: WF_ALLOC_STATS_HPP */
@@ -26,11 +26,13 @@ extern "C"
 }
 
 #include <sys/wait.h>
+#include <signal.h>
 #include <unistd.h>
 #include <fcntl.h>
 
 #include "debug.hpp"
 #include "opengl-priv.hpp"
+#include "startup-trace.hpp"
 #include "output.hpp"
 #include "workspace-manager.hpp"
 #include "seat/input-manager.hpp"
@@ -118,7 +120,10 @@ void wf::compositor_core_impl_t::init()
      * init_desktop_apis() should come before input */
     output_layout = std::make_unique<wf::output_layout_t> (backend);
     compositor = wlr_compositor_create(display, renderer);
-    init_desktop_apis(config);
+    {
+        wf::startup_trace::scope_t trace("desktop APIs");
+        init_desktop_apis(config);
+    }
 
     /* Somehow GTK requires the tablet_v2 to be advertised pretty early */
     protocols.tablet_v2 = wlr_tablet_v2_create(display);
@@ -177,7 +182,10 @@ void wf::compositor_core_impl_t::init()
     gtk_shell = wf_gtk_shell_create(display);
 
     image_io::init();
-    OpenGL::init();
+    {
+        wf::startup_trace::scope_t trace("OpenGL init");
+        OpenGL::init();
+    }
 }
 
 wlr_seat* wf::compositor_core_impl_t::get_current_seat()
@@ -472,6 +480,12 @@ void wf::compositor_core_impl_t::run(std::string command)
                 setenv("DISPLAY", xdisp.c_str(), 1);
             }
 #endif
+            /* The event loop blocks the signals it handles, for ex. SIGUSR2
+             * for event tracing, and the mask is inherited across exec */
+            sigset_t mask;
+            sigemptyset(&mask);
+            sigprocmask(SIG_SETMASK, &mask, NULL);
+
             int dev_null = open("/dev/null", O_WRONLY);
             dup2(dev_null, 1);
             dup2(dev_null, 2);
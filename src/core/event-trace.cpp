@@ -0,0 +1,233 @@
+#include "event-trace.hpp"
+#include "debug.hpp"
+
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_set>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <csignal>
+#include <unistd.h>
+
+#include <wayland-server.h>
+
+namespace
+{
+    /* Number of events kept per thread, about 0.75MB of memory */
+    constexpr uint64_t buffer_capacity = 1 << 15;
+
+    /* Fields are atomic only so that flush() can read them while the owning
+     * thread keeps recording, they are always accessed with relaxed order */
+    struct event_t
+    {
+        std::atomic<const char*> name;
+        std::atomic<int64_t> timestamp_ns;
+        std::atomic<char> phase;
+    };
+
+    /* A single-producer ring buffer owned by one thread */
+    struct thread_buffer_t
+    {
+        int tid;
+        std::atomic<const char*> name{nullptr};
+        /* Total number of recorded events, published with release order */
+        std::atomic<uint64_t> head{0};
+        event_t events[buffer_capacity];
+    };
+
+    std::string trace_path;
+
+    /* Buffers are registered once per thread and never freed, so that
+     * events of threads which have exited can still be flushed */
+    std::mutex buffers_mutex;
+    std::vector<std::unique_ptr<thread_buffer_t>> buffers;
+
+    std::mutex interned_mutex;
+    std::unordered_set<std::string> interned;
+
+    thread_buffer_t *get_thread_buffer()
+    {
+        thread_local thread_buffer_t *buffer = nullptr;
+        if (!buffer)
+        {
+            std::lock_guard<std::mutex> lock(buffers_mutex);
+            buffers.push_back(std::make_unique<thread_buffer_t>());
+            buffer = buffers.back().get();
+            buffer->tid = buffers.size();
+        }
+
+        return buffer;
+    }
+
+    int64_t get_timestamp_ns()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec * 1000000000ll + now.tv_nsec;
+    }
+
+    struct event_copy_t
+    {
+        const char *name;
+        int64_t timestamp_ns;
+        char phase;
+    };
+
+    /* Copy the events which are currently in the buffer, dropping those
+     * which the owning thread might have overwritten in the meantime */
+    std::vector<event_copy_t> copy_events(thread_buffer_t& buffer)
+    {
+        uint64_t head = buffer.head.load(std::memory_order_acquire);
+        uint64_t first = head > buffer_capacity ? head - buffer_capacity : 0;
+
+        std::vector<event_copy_t> copy;
+        copy.reserve(head - first);
+        for (uint64_t i = first; i < head; i++)
+        {
+            auto& ev = buffer.events[i % buffer_capacity];
+            copy.push_back({ev.name.load(std::memory_order_relaxed),
+                ev.timestamp_ns.load(std::memory_order_relaxed),
+                ev.phase.load(std::memory_order_relaxed)});
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t new_head = buffer.head.load(std::memory_order_relaxed);
+
+        /* The slot of event new_head - capacity might be in the middle of
+         * being overwritten, so it is dropped as well */
+        uint64_t valid = new_head >= buffer_capacity ?
+            new_head - buffer_capacity + 1 : 0;
+        if (valid > first)
+            copy.erase(copy.begin(), copy.begin() + std::min(valid - first,
+                    (uint64_t)copy.size()));
+
+        return copy;
+    }
+
+    std::string escape_json(const char *str)
+    {
+        std::string result;
+        for (; *str; ++str)
+        {
+            if (*str == '"' || *str == '\\')
+                result += '\\';
+
+            if ((unsigned char)*str >= 0x20)
+                result += *str;
+        }
+
+        return result;
+    }
+
+    int handle_flush_signal(int signal, void *data)
+    {
+        wf::event_trace::flush(trace_path);
+        return 0;
+    }
+}
+
+namespace wf
+{
+namespace event_trace
+{
+bool enabled = false;
+
+void init(wl_event_loop *loop)
+{
+    auto env = getenv("WAYFIRE_TRACE");
+    if (!env || !*env)
+        return;
+
+    trace_path = env;
+    enabled = true;
+    set_thread_name("main");
+
+    wl_event_loop_add_signal(loop, SIGUSR2, handle_flush_signal, NULL);
+    log_info("event tracing enabled, send SIGUSR2 to write the trace to %s",
+        trace_path.c_str());
+}
+
+void record(const char *name, char phase)
+{
+    auto buffer = get_thread_buffer();
+
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    auto& ev = buffer->events[head % buffer_capacity];
+    ev.name.store(name, std::memory_order_relaxed);
+    ev.timestamp_ns.store(get_timestamp_ns(), std::memory_order_relaxed);
+    ev.phase.store(phase, std::memory_order_relaxed);
+
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+const char *intern(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(interned_mutex);
+    return interned.insert(name).first->c_str();
+}
+
+void set_thread_name(const char *name)
+{
+    if (enabled)
+        get_thread_buffer()->name.store(name, std::memory_order_relaxed);
+}
+
+bool flush(const std::string& path)
+{
+    auto file = std::fopen(path.c_str(), "w");
+    if (!file)
+    {
+        log_error("event trace: failed to open %s", path.c_str());
+        return false;
+    }
+
+    int pid = getpid();
+    bool first_event = true;
+    auto separate = [&] () {
+        std::fprintf(file, first_event ? "\n" : ",\n");
+        first_event = false;
+    };
+
+    std::fprintf(file, "{\"traceEvents\":[");
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for (auto& buffer : buffers)
+    {
+        auto thread_name = buffer->name.load(std::memory_order_relaxed);
+        if (thread_name)
+        {
+            separate();
+            std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\","
+                "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                pid, buffer->tid, escape_json(thread_name).c_str());
+        }
+
+        /* The beginning of events at the start of the buffer may have been
+         * overwritten already, so skip their ends */
+        int depth = 0;
+        for (auto& ev : copy_events(*buffer))
+        {
+            if (ev.phase == 'E' && depth == 0)
+                continue;
+
+            depth += (ev.phase == 'B') ? 1 : -1;
+            separate();
+            std::fprintf(file, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%ld.%03ld,"
+                "\"pid\":%d,\"tid\":%d}", escape_json(ev.name).c_str(),
+                ev.phase, (long)(ev.timestamp_ns / 1000),
+                (long)(ev.timestamp_ns % 1000), pid, buffer->tid);
+        }
+    }
+
+    std::fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    std::fclose(file);
+
+    log_info("event trace written to %s", path.c_str());
+    return true;
+}
+}
+}
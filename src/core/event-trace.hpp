@@ -0,0 +1,84 @@
+#ifndef WF_EVENT_TRACE_HPP
+#define WF_EVENT_TRACE_HPP
+
+#include <string>
+
+extern "C"
+{
+    struct wl_event_loop;
+}
+
+/**
+ * Low-overhead tracing of what the compositor does over time, i.e how input
+ * handling, client commits, idle callbacks, timers, signals and repaints are
+ * interleaved in the main loop.
+ *
+ * Enabled by setting WAYFIRE_TRACE to the path of a trace file. Each thread
+ * records begin/end events in its own fixed-size ring buffer without taking
+ * any locks, so only the most recent events are kept. Sending SIGUSR2 to the
+ * compositor writes them to the trace file as Chrome trace-event JSON, which
+ * can be opened in chrome://tracing or Perfetto.
+ */
+namespace wf
+{
+namespace event_trace
+{
+/** Read the environment and set up the flush signal handler. Must be called
+ * before any other threads are started. */
+void init(wl_event_loop *loop);
+
+/* Whether events are being recorded. Doesn't change after init() */
+extern bool enabled;
+
+/** Record an event in the buffer of the current thread.
+ * The name isn't copied, so it must be a string literal or intern()-ed. */
+void record(const char *name, char phase);
+
+/** Get a copy of the string which lives until the end of the program, so that
+ * it can be used as an event name. */
+const char *intern(const std::string& name);
+
+/** Name the current thread in the trace. Same lifetime rules as record() */
+void set_thread_name(const char *name);
+
+/** Write the recorded events to the given file.
+ * Must be called on the main thread. */
+bool flush(const std::string& path);
+
+inline void begin(const char *name)
+{
+    if (enabled)
+        record(name, 'B');
+}
+
+inline void end(const char *name)
+{
+    if (enabled)
+        record(name, 'E');
+}
+
+/** Records a begin event on creation and an end event on destruction */
+class scope_t
+{
+  public:
+    scope_t(const char *name)
+        : name(name)
+    {
+        begin(name);
+    }
+
+    ~scope_t()
+    {
+        end(name);
+    }
+
+    scope_t(const scope_t&) = delete;
+    scope_t& operator = (const scope_t&) = delete;
+
+  private:
+    const char *name;
+};
+}
+}
+
+#endif /* end of include guard: WF_EVENT_TRACE_HPP */
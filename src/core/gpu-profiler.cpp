@@ -0,0 +1,491 @@
+#include "gpu-profiler.hpp"
+#include "opengl.hpp"
+#include "debug.hpp"
+
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#include <cstring>
+#include <ctime>
+
+namespace
+{
+    constexpr int64_t report_period_us = 1000000;
+    /* Frames whose results still aren't available after this many newer
+     * frames are dropped, so that a stuck GPU doesn't make us leak queries */
+    constexpr size_t max_pending_frames = 8;
+
+    enum interval_kind_t
+    {
+        INTERVAL_PASS,
+        INTERVAL_PLUGIN,
+        INTERVAL_FRAME,
+    };
+
+    struct interval_t
+    {
+        interval_kind_t kind;
+        /* The name of the pass or of the plugin */
+        std::string name;
+        /* Timestamp queries at both ends, or an elapsed time query in begin
+         * and 0 in end if the driver has no timestamps */
+        GLuint begin, end;
+    };
+
+    struct frame_queries_t
+    {
+        std::vector<GLuint> queries;
+        std::vector<interval_t> intervals;
+    };
+
+    struct pass_stats_t
+    {
+        int calls = 0;
+        int64_t cpu_us = 0;
+        int64_t gpu_ns = 0;
+        bool has_gpu = false;
+    };
+
+    struct gpu_profiler_state_t
+    {
+        int enable_counter = 0;
+
+        bool checked = false;
+        bool supported = false;
+        bool has_timestamps = false;
+        /* The query functions of GL_EXT_disjoint_timer_query. The core GLES3
+         * functions can't be used, because the extension is also available
+         * with GLES2 contexts */
+        PFNGLGENQUERIESEXTPROC gen_queries = nullptr;
+        PFNGLDELETEQUERIESEXTPROC delete_queries = nullptr;
+        PFNGLBEGINQUERYEXTPROC begin_query = nullptr;
+        PFNGLENDQUERYEXTPROC end_query = nullptr;
+        PFNGLGETQUERYIVEXTPROC get_query = nullptr;
+        PFNGLGETQUERYOBJECTUIVEXTPROC get_query_available = nullptr;
+        PFNGLQUERYCOUNTEREXTPROC query_counter = nullptr;
+        PFNGLGETQUERYOBJECTUI64VEXTPROC get_query_result = nullptr;
+
+        /* Whether an output is being repainted */
+        bool in_frame = false;
+        GLuint frame_begin = 0;
+        GLuint last_plugin_switch = 0;
+        /* Elapsed time queries can't be nested, so without timestamps only
+         * one pass at a time is measured */
+        bool elapsed_running = false;
+
+        frame_queries_t current;
+        std::deque<frame_queries_t> pending;
+        std::vector<GLuint> free_queries;
+
+        std::unordered_map<std::string, pass_stats_t> passes;
+        std::unordered_map<std::string, int64_t> plugins_gpu_ns;
+        int64_t frame_gpu_ns = 0;
+        int64_t period_start_us = -1;
+        int period_frames = 0;
+        /* Number of frames whose GPU times were read in this period */
+        int period_gpu_frames = 0;
+
+        std::vector<wf::gpu_profiler::pass_time_t> last_passes;
+        std::unordered_map<std::string, double> last_plugins;
+        double last_frame_gpu_ms = -1;
+    } gpu;
+
+    int64_t get_time_us()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec * 1000000ll + now.tv_nsec / 1000ll;
+    }
+
+    /* Needs a current GL context, so it is done on the first profiled frame */
+    void check_support()
+    {
+        gpu.checked = true;
+
+        auto extensions = (const char*)GL_CALL(glGetString(GL_EXTENSIONS));
+        if (!extensions || !std::strstr(extensions, "GL_EXT_disjoint_timer_query"))
+        {
+            log_info("GPU profiler: GL_EXT_disjoint_timer_query is not "
+                "supported, only CPU times are measured");
+            return;
+        }
+
+        gpu.gen_queries = (PFNGLGENQUERIESEXTPROC)
+            eglGetProcAddress("glGenQueriesEXT");
+        gpu.delete_queries = (PFNGLDELETEQUERIESEXTPROC)
+            eglGetProcAddress("glDeleteQueriesEXT");
+        gpu.begin_query = (PFNGLBEGINQUERYEXTPROC)
+            eglGetProcAddress("glBeginQueryEXT");
+        gpu.end_query = (PFNGLENDQUERYEXTPROC)
+            eglGetProcAddress("glEndQueryEXT");
+        gpu.get_query = (PFNGLGETQUERYIVEXTPROC)
+            eglGetProcAddress("glGetQueryivEXT");
+        gpu.get_query_available = (PFNGLGETQUERYOBJECTUIVEXTPROC)
+            eglGetProcAddress("glGetQueryObjectuivEXT");
+        gpu.query_counter = (PFNGLQUERYCOUNTEREXTPROC)
+            eglGetProcAddress("glQueryCounterEXT");
+        gpu.get_query_result = (PFNGLGETQUERYOBJECTUI64VEXTPROC)
+            eglGetProcAddress("glGetQueryObjectui64vEXT");
+
+        if (!gpu.gen_queries || !gpu.delete_queries || !gpu.begin_query ||
+            !gpu.end_query || !gpu.get_query || !gpu.get_query_available ||
+            !gpu.get_query_result)
+        {
+            log_error("GPU profiler: failed to load the timer query functions");
+            return;
+        }
+
+        gpu.supported = true;
+
+        /* Some drivers expose the extension without timestamps and report
+         * 0 bits or reject the query, which shouldn't be logged as an error */
+        GLint bits = 0;
+        if (gpu.query_counter)
+        {
+            gpu.get_query(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &bits);
+            glGetError();
+        }
+
+        gpu.has_timestamps = bits > 0;
+
+        /* Reset the disjoint flag */
+        GLint disjoint;
+        GL_CALL(glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint));
+
+        log_info("GPU profiler: using %s queries",
+            gpu.has_timestamps ? "timestamp" : "elapsed time");
+    }
+
+    GLuint allocate_query()
+    {
+        GLuint query;
+        if (gpu.free_queries.empty())
+        {
+            GL_CALL(gpu.gen_queries(1, &query));
+        } else
+        {
+            query = gpu.free_queries.back();
+            gpu.free_queries.pop_back();
+        }
+
+        gpu.current.queries.push_back(query);
+        return query;
+    }
+
+    GLuint issue_timestamp()
+    {
+        auto query = allocate_query();
+        GL_CALL(gpu.query_counter(query, GL_TIMESTAMP_EXT));
+        return query;
+    }
+
+    void release_queries(frame_queries_t& frame)
+    {
+        gpu.free_queries.insert(gpu.free_queries.end(),
+            frame.queries.begin(), frame.queries.end());
+    }
+
+    bool results_available(const frame_queries_t& frame)
+    {
+        for (auto query : frame.queries)
+        {
+            GLuint available = 0;
+            GL_CALL(gpu.get_query_available(query,
+                    GL_QUERY_RESULT_AVAILABLE_EXT, &available));
+            if (!available)
+                return false;
+        }
+
+        return true;
+    }
+
+    void accumulate_results(const frame_queries_t& frame)
+    {
+        std::unordered_map<GLuint, GLuint64> values;
+        for (auto query : frame.queries)
+        {
+            GL_CALL(gpu.get_query_result(query, GL_QUERY_RESULT_EXT,
+                    &values[query]));
+        }
+
+        /* The timer was reset since the queries were issued, so they may
+         * contain garbage */
+        GLint disjoint = 0;
+        GL_CALL(glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint));
+        if (disjoint)
+            return;
+
+        for (auto& interval : frame.intervals)
+        {
+            int64_t ns = values[interval.begin];
+            if (interval.end)
+                ns = std::max<int64_t>(values[interval.end] - ns, 0);
+
+            switch (interval.kind)
+            {
+                case INTERVAL_PASS:
+                    gpu.passes[interval.name].gpu_ns += ns;
+                    gpu.passes[interval.name].has_gpu = true;
+                    break;
+                case INTERVAL_PLUGIN:
+                    gpu.plugins_gpu_ns[interval.name] += ns;
+                    break;
+                case INTERVAL_FRAME:
+                    gpu.frame_gpu_ns += ns;
+                    break;
+            }
+        }
+
+        ++gpu.period_gpu_frames;
+    }
+
+    /* Read the results of the oldest frames, without waiting for the GPU */
+    void read_results()
+    {
+        while (!gpu.pending.empty())
+        {
+            auto& frame = gpu.pending.front();
+            if (results_available(frame))
+            {
+                accumulate_results(frame);
+            } else if (gpu.pending.size() <= max_pending_frames)
+            {
+                break;
+            }
+
+            release_queries(frame);
+            gpu.pending.pop_front();
+        }
+    }
+
+    /* Delete all queries, including those whose results weren't read */
+    void delete_queries()
+    {
+        for (auto& frame : gpu.pending)
+            release_queries(frame);
+        release_queries(gpu.current);
+
+        if (!gpu.free_queries.empty())
+        {
+            OpenGL::render_begin();
+            GL_CALL(gpu.delete_queries(gpu.free_queries.size(),
+                    gpu.free_queries.data()));
+            OpenGL::render_end();
+        }
+
+        gpu.pending.clear();
+        gpu.current = {};
+        gpu.free_queries.clear();
+        gpu.in_frame = false;
+        gpu.elapsed_running = false;
+    }
+
+    void make_report(int64_t now)
+    {
+        auto& report = gpu.last_passes;
+        report.clear();
+
+        int gpu_frames = std::max(gpu.period_gpu_frames, 1);
+        for (auto& entry : gpu.passes)
+        {
+            wf::gpu_profiler::pass_time_t pass;
+            pass.name = entry.first;
+            pass.calls = 1.0 * entry.second.calls / gpu.period_frames;
+            pass.cpu_avg_ms = entry.second.cpu_us / 1000.0 / gpu.period_frames;
+            if (entry.second.has_gpu)
+                pass.gpu_avg_ms = entry.second.gpu_ns / 1e6 / gpu_frames;
+
+            report.push_back(pass);
+        }
+
+        std::sort(report.begin(), report.end(), [] (auto& a, auto& b) {
+            if (a.gpu_avg_ms != b.gpu_avg_ms)
+                return a.gpu_avg_ms > b.gpu_avg_ms;
+            return a.cpu_avg_ms > b.cpu_avg_ms;
+        });
+
+        gpu.last_plugins.clear();
+        for (auto& entry : gpu.plugins_gpu_ns)
+            gpu.last_plugins[entry.first] = entry.second / 1e6 / gpu_frames;
+
+        gpu.last_frame_gpu_ms = -1;
+        if (gpu.has_timestamps && gpu.period_gpu_frames)
+            gpu.last_frame_gpu_ms = gpu.frame_gpu_ns / 1e6 / gpu_frames;
+
+        gpu.passes.clear();
+        gpu.plugins_gpu_ns.clear();
+        gpu.frame_gpu_ns = 0;
+        gpu.period_start_us = now;
+        gpu.period_frames = 0;
+        gpu.period_gpu_frames = 0;
+    }
+}
+
+namespace wf
+{
+namespace gpu_profiler
+{
+void set_enabled(bool enabled)
+{
+    gpu.enable_counter += enabled ? 1 : -1;
+    if (gpu.enable_counter < 0)
+    {
+        log_error("GPU profiler enable counter got below 0!");
+        gpu.enable_counter = 0;
+    }
+
+    if (!enabled && gpu.enable_counter == 0)
+        delete_queries();
+
+    if (enabled && gpu.enable_counter == 1)
+    {
+        gpu.passes.clear();
+        gpu.plugins_gpu_ns.clear();
+        gpu.frame_gpu_ns = 0;
+        gpu.period_start_us = -1;
+        gpu.period_frames = 0;
+        gpu.period_gpu_frames = 0;
+
+        gpu.last_passes.clear();
+        gpu.last_plugins.clear();
+        gpu.last_frame_gpu_ms = -1;
+    }
+}
+
+bool is_enabled()
+{
+    return gpu.enable_counter > 0;
+}
+
+bool is_supported()
+{
+    return gpu.supported;
+}
+
+scope_t::scope_t(const char *name) : name(name)
+{
+    if (!gpu.enable_counter)
+        return;
+
+    cpu_start_us = get_time_us();
+    if (!gpu.in_frame)
+        return;
+
+    if (gpu.has_timestamps)
+    {
+        query = issue_timestamp();
+    } else if (!gpu.elapsed_running)
+    {
+        query = allocate_query();
+        GL_CALL(gpu.begin_query(GL_TIME_ELAPSED_EXT, query));
+        gpu.elapsed_running = true;
+    }
+}
+
+scope_t::~scope_t()
+{
+    if (cpu_start_us < 0)
+        return;
+
+    auto& stats = gpu.passes[name];
+    stats.cpu_us += get_time_us() - cpu_start_us;
+    ++stats.calls;
+
+    if (!query || !gpu.in_frame)
+        return;
+
+    if (gpu.has_timestamps)
+    {
+        auto end = issue_timestamp();
+        gpu.current.intervals.push_back({INTERVAL_PASS, name, query, end});
+    } else
+    {
+        GL_CALL(gpu.end_query(GL_TIME_ELAPSED_EXT));
+        gpu.elapsed_running = false;
+        gpu.current.intervals.push_back({INTERVAL_PASS, name, query, 0});
+    }
+}
+
+std::vector<pass_time_t> get_pass_times()
+{
+    return gpu.last_passes;
+}
+
+double get_frame_gpu_ms()
+{
+    return gpu.last_frame_gpu_ms;
+}
+
+double get_plugin_gpu_ms(const std::string& plugin)
+{
+    auto it = gpu.last_plugins.find(plugin);
+    if (it == gpu.last_plugins.end())
+        return gpu.has_timestamps && gpu.last_frame_gpu_ms >= 0 ? 0 : -1;
+
+    return it->second;
+}
+
+void begin_frame()
+{
+    if (!gpu.enable_counter)
+        return;
+
+    if (!gpu.checked)
+        check_support();
+
+    if (!gpu.supported)
+        return;
+
+    gpu.in_frame = true;
+    if (gpu.has_timestamps)
+        gpu.frame_begin = gpu.last_plugin_switch = issue_timestamp();
+}
+
+void end_frame()
+{
+    if (!gpu.enable_counter)
+        return;
+
+    if (gpu.in_frame)
+    {
+        if (gpu.has_timestamps)
+        {
+            auto end = issue_timestamp();
+            gpu.current.intervals.push_back(
+                {INTERVAL_FRAME, "", gpu.frame_begin, end});
+        }
+
+        gpu.in_frame = false;
+        gpu.pending.push_back(std::move(gpu.current));
+        gpu.current = {};
+        read_results();
+    }
+
+    int64_t now = get_time_us();
+    if (gpu.period_start_us < 0)
+        gpu.period_start_us = now;
+
+    ++gpu.period_frames;
+    if (now - gpu.period_start_us >= report_period_us)
+        make_report(now);
+}
+
+void plugin_switched(const std::string& previous)
+{
+    if (!gpu.in_frame || !gpu.has_timestamps)
+        return;
+
+    auto query = issue_timestamp();
+    if (!previous.empty())
+    {
+        gpu.current.intervals.push_back(
+            {INTERVAL_PLUGIN, previous, gpu.last_plugin_switch, query});
+    }
+
+    gpu.last_plugin_switch = query;
+}
+}
+}
@@ -1,6 +1,7 @@
 #include "img.hpp"
 #include "opengl.hpp"
 #include "debug.hpp"
+#include "event-trace.hpp"
 
 #ifdef BUILD_WITH_IMAGEIO
 #include <png.h>
@@ -10,15 +11,29 @@
 
 #include <stdint.h>
 #include <unistd.h>
+#include <csetjmp>
 #include <cstdio>
 #include <unordered_map>
 #include <functional>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <map>
+#include <tuple>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+#include "core.hpp"
+#include <wayland-server.h>
 
 #define TEXTURE_LOAD_ERROR 0
 
 namespace image_io {
-    using Loader = std::function<bool(const char *, GLuint)>;
-    using Writer = std::function<void(const char *name, uint8_t *pixels, unsigned long, unsigned long)>;
+    using Loader = std::function<bool(const char *, image_t&)>;
+    using Writer = std::function<bool(const char *name, uint8_t *pixels, unsigned long, unsigned long)>;
     namespace {
         std::unordered_map<std::string, Loader> loaders;
         std::unordered_map<std::string, Writer> writers;
@@ -27,24 +42,44 @@ namespace image_io {
 #ifdef BUILD_WITH_IMAGEIO
     /* All backend functions are taken from the internet.
      * If you want to be credited, contact me */
-    bool texture_from_png(const char *filename, GLuint target)
+    bool image_from_png(const char *filename, image_t& image)
     {
         FILE *fp = fopen(filename, "rb");
         int width, height;
         png_byte color_type;
         png_byte bit_depth;
-        png_bytep *row_pointers;
+
+        /* Not a local, so that it is safe to use after setjmp() */
+        static thread_local std::vector<png_bytep> row_pointers;
+
+        if (!fp)
+        {
+            log_error("failed to read PNG file %s", filename);
+            return false;
+        }
 
         png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
         if(!png)
+        {
+            fclose(fp);
             return false;
+        }
 
         png_infop infos = png_create_info_struct(png);
         if(!infos)
+        {
+            png_destroy_read_struct(&png, NULL, NULL);
+            fclose(fp);
             return false;
+        }
 
         if(setjmp(png_jmpbuf(png)))
+        {
+            log_error("failed to decode PNG file %s", filename);
+            png_destroy_read_struct(&png, &infos, NULL);
+            fclose(fp);
             return false;
+        }
 
         png_init_io(png, fp);
         png_read_info(png, infos);
@@ -79,42 +114,41 @@ namespace image_io {
 
         png_read_update_info(png, infos);
 
-        row_pointers = new png_bytep[height];
-        png_byte *data = new png_byte[height * png_get_rowbytes(png, infos)];
+        auto stride = png_get_rowbytes(png, infos);
+        image.width = width;
+        image.height = height;
+        image.format = GL_RGBA;
+        image.pixels.resize(height * stride);
 
+        row_pointers.resize(height);
         for(int i = 0; i < height; i++)
         {
-            row_pointers[i] = data + i * png_get_rowbytes(png, infos);
+            row_pointers[i] = image.pixels.data() + i * stride;
         }
 
-        png_read_image(png, row_pointers);
-        GL_CALL(glTexImage2D(target, 0, GL_RGBA, width, height, 0,
-                             GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid *) data));
-
+        png_read_image(png, row_pointers.data());
         png_destroy_read_struct(&png, &infos, NULL);
-        delete[] row_pointers;
-        delete[] data;
 
         fclose(fp);
         return true;
     }
 
-    void texture_to_png(const char *name, uint8_t *pixels, int w, int h)
+    bool texture_to_png(const char *name, uint8_t *pixels, int w, int h)
     {
         png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
         if (!png)
-            return;
+            return false;
 
         png_infop infot = png_create_info_struct(png);
         if (!infot) {
             png_destroy_write_struct(&png, &infot);
-            return;
+            return false;
         }
 
         FILE *fp = fopen(name, "wb");
         if (!fp) {
             png_destroy_write_struct(&png, &infot);
-            return;
+            return false;
         }
 
         png_init_io(png, fp);
@@ -124,69 +158,93 @@ namespace image_io {
         if (!palette) {
             fclose(fp);
             png_destroy_write_struct(&png, &infot);
-            return;
+            return false;
         }
         png_set_PLTE(png, infot, palette, PNG_MAX_PALETTE_LENGTH);
         png_write_info(png, infot);
         png_set_packing(png);
 
         png_bytepp rows = (png_bytepp)png_malloc(png, h * sizeof(png_bytep));
+        /* The pixels come from GL, so rows are ordered bottom to top */
         for (int i = 0; i < h; ++i)
-            rows[i] = (png_bytep)(pixels + (h - i) * w * 4);
+            rows[i] = (png_bytep)(pixels + (h - 1 - i) * w * 4);
 
         png_write_image(png, rows);
         png_write_end(png, infot);
         png_free(png, palette);
+        png_free(png, rows);
         png_destroy_write_struct(&png, &infot);
 
         fclose(fp);
-        delete[] rows;
+        return true;
     }
 
-    bool texture_from_jpeg(const char *FileName, GLuint target)
+    struct jpeg_error_handler_t
+    {
+        jpeg_error_mgr mgr;
+        jmp_buf jump;
+    };
+
+    /* The default handler calls exit(), which would take down the compositor
+     * with a single broken image */
+    void handle_jpeg_error(j_common_ptr info)
+    {
+        char message[JMSG_LENGTH_MAX];
+        (*info->err->format_message) (info, message);
+        log_error("failed to decode JPEG: %s", message);
+
+        longjmp(((jpeg_error_handler_t*)info->err)->jump, 1);
+    }
+
+    bool image_from_jpeg(const char *FileName, image_t& image)
     {
-        unsigned long data_size;
         unsigned char *rowptr[1];
-        unsigned char *jdata;
         struct jpeg_decompress_struct infot;
-        struct jpeg_error_mgr err;
+        jpeg_error_handler_t err;
 
         std::FILE *file = fopen(FileName, "rb");
-        infot.err = jpeg_std_error(& err);
-        jpeg_create_decompress(&infot);
-
         if(!file)
         {
             log_error("failed to read JPEG file %s", FileName);
             return false;
         }
 
+        infot.err = jpeg_std_error(&err.mgr);
+        err.mgr.error_exit = handle_jpeg_error;
+        jpeg_create_decompress(&infot);
+
+        if (setjmp(err.jump))
+        {
+            jpeg_destroy_decompress(&infot);
+            fclose(file);
+            return false;
+        }
+
         jpeg_stdio_src(&infot, file);
         jpeg_read_header(&infot, TRUE);
+        infot.out_color_space = JCS_RGB;
         jpeg_start_decompress(&infot);
 
-        data_size = infot.output_width * infot.output_height * 3;
+        image.width = infot.output_width;
+        image.height = infot.output_height;
+        image.format = GL_RGB;
+        image.pixels.resize(infot.output_width * infot.output_height * 3);
 
-        jdata = new unsigned char[data_size];
         while (infot.output_scanline < infot.output_height) {
-            rowptr[0] = (unsigned char *)jdata +  3* infot.output_width * infot.output_scanline;
+            rowptr[0] = image.pixels.data() + 3 * infot.output_width * infot.output_scanline;
             jpeg_read_scanlines(&infot, rowptr, 1);
         }
 
         jpeg_finish_decompress(&infot);
-
-        GL_CALL(glTexImage2D(target, 0, GL_RGB,
-                infot.output_width, infot.output_height,
-                0, GL_RGB, GL_UNSIGNED_BYTE, jdata));
+        jpeg_destroy_decompress(&infot);
 
         fclose(file);
-        delete[] jdata;
-
         return true;
     }
 #endif
 
-    bool load_from_file(std::string name, GLuint target)
+    /* Decode the given file with the loader for its extension */
+    bool decode_file(const std::string& name, image_t& image)
     {
         if (access(name.c_str(), F_OK) == -1) {
             if (!name.empty())
@@ -209,8 +267,350 @@ namespace image_io {
             log_error("load_from_file() called with unsupported extension %s", ext.c_str());
             return false;
         } else {
-            return it->second(name.c_str(), target);
+            return it->second(name.c_str(), image);
+        }
+    }
+
+    void upload(const image_t& image, GLuint target)
+    {
+        /* Rows of RGB images aren't necessarily 4-byte aligned */
+        GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+        GL_CALL(glTexImage2D(target, 0, image.format, image.width, image.height,
+                0, image.format, GL_UNSIGNED_BYTE, image.pixels.data()));
+        GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+    }
+
+    void upload_placeholder(GLuint target)
+    {
+        static const uint8_t black[] = {0, 0, 0, 255};
+        GL_CALL(glTexImage2D(target, 0, GL_RGBA, 1, 1,
+                0, GL_RGBA, GL_UNSIGNED_BYTE, black));
+    }
+
+    bool load_from_file(std::string name, GLuint target)
+    {
+        image_t image;
+        if (!decode_file(name, image))
+            return false;
+
+        upload(image, target);
+        return true;
+    }
+
+    namespace {
+        /**
+         * Runs jobs such as decoding and encoding images on a worker thread.
+         * Finished jobs are passed back to the main loop through an eventfd,
+         * where their finish callbacks are run.
+         */
+        struct async_worker_t
+        {
+            struct job_t
+            {
+                uint32_t id;
+                std::function<void()> work;
+            };
+
+            /* Shared with the worker thread, protected by mutex */
+            std::mutex mutex;
+            std::condition_variable queue_changed;
+            std::deque<job_t> queued;
+            std::deque<uint32_t> finished;
+            bool stopping = false;
+
+            std::thread worker;
+            int event_fd = -1;
+
+            /* Used only on the main thread */
+            uint32_t last_id = 0;
+            std::unordered_map<uint32_t, std::function<void()>> finish_callbacks;
+
+            ~async_worker_t()
+            {
+                if (worker.joinable())
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        stopping = true;
+                    }
+
+                    queue_changed.notify_one();
+                    worker.join();
+                }
+
+                if (event_fd >= 0)
+                    close(event_fd);
+            }
+
+            static int handle_finished(int fd, uint32_t mask, void *data)
+            {
+                uint64_t count;
+                if (read(fd, &count, sizeof(count)) < 0)
+                    log_error("failed to read image worker eventfd");
+
+                auto self = (async_worker_t*)data;
+                std::deque<uint32_t> jobs;
+                {
+                    std::lock_guard<std::mutex> lock(self->mutex);
+                    std::swap(jobs, self->finished);
+                }
+
+                for (auto id : jobs)
+                    self->finish(id);
+
+                return 0;
+            }
+
+            struct idle_job_t
+            {
+                async_worker_t *worker;
+                uint32_t id;
+            };
+
+            static void handle_idle_finish(void *data)
+            {
+                auto job = (idle_job_t*)data;
+                job->worker->finish(job->id);
+                delete job;
+            }
+
+            void init()
+            {
+                event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+                if (event_fd < 0)
+                {
+                    log_error("failed to create eventfd for the image worker");
+                    return;
+                }
+
+                wl_event_loop_add_fd(wf::get_core().ev_loop, event_fd,
+                    WL_EVENT_READABLE, handle_finished, this);
+            }
+
+            void run_worker()
+            {
+                wf::event_trace::set_thread_name("image worker");
+
+                std::unique_lock<std::mutex> lock(mutex);
+                while (true)
+                {
+                    queue_changed.wait(lock,
+                        [=] () { return stopping || !queued.empty(); });
+                    if (stopping)
+                        return;
+
+                    auto job = std::move(queued.front());
+                    queued.pop_front();
+
+                    lock.unlock();
+                    {
+                        wf::event_trace::scope_t trace("image job");
+                        job.work();
+                    }
+                    lock.lock();
+
+                    finished.push_back(job.id);
+
+                    uint64_t one = 1;
+                    if (write(event_fd, &one, sizeof(one)) < 0)
+                        log_error("failed to notify main loop of finished job");
+                }
+            }
+
+            void finish(uint32_t id)
+            {
+                auto it = finish_callbacks.find(id);
+                if (it == finish_callbacks.end())
+                    return;
+
+                /* Erase first, the callback may submit new jobs */
+                auto callback = std::move(it->second);
+                finish_callbacks.erase(it);
+                callback();
+            }
+
+            /* Run work on the worker thread, and then finish on the main loop.
+             * finish is never called synchronously. */
+            uint32_t submit(std::function<void()> work,
+                std::function<void()> finish)
+            {
+                if (++last_id == 0)
+                    ++last_id;
+
+                finish_callbacks[last_id] = std::move(finish);
+
+                if (event_fd < 0)
+                {
+                    /* No way to get back to the main loop from the worker */
+                    work();
+                    wl_event_loop_add_idle(wf::get_core().ev_loop,
+                        handle_idle_finish, new idle_job_t{this, last_id});
+                    return last_id;
+                }
+
+                if (!worker.joinable())
+                    worker = std::thread([=] () { run_worker(); });
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    queued.push_back({last_id, std::move(work)});
+                }
+
+                queue_changed.notify_one();
+                return last_id;
+            }
+
+            /* Make sure the finish callback of the job won't be called, and
+             * don't start the job if it is still queued */
+            void cancel(uint32_t id)
+            {
+                finish_callbacks.erase(id);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                queued.erase(std::remove_if(queued.begin(), queued.end(),
+                        [=] (const job_t& job) { return job.id == id; }),
+                    queued.end());
+            }
+        } image_worker;
+
+        /* Decoded images are recycled, so that reloading images of the same
+         * size doesn't need new allocations */
+        static constexpr size_t max_pooled_images = 2;
+        std::vector<std::unique_ptr<image_t>> image_pool;
+
+        struct decode_request_t
+        {
+            std::string name;
+            std::unique_ptr<image_t> image;
+            bool success = false;
+        };
+    }
+
+    uint32_t decode_async(std::string name, decode_callback_t callback)
+    {
+        auto request = std::make_shared<decode_request_t>();
+        request->name = std::move(name);
+        if (image_pool.empty())
+        {
+            request->image = std::make_unique<image_t>();
+        } else
+        {
+            request->image = std::move(image_pool.back());
+            image_pool.pop_back();
+        }
+
+        return image_worker.submit([request] () {
+            request->success = decode_file(request->name, *request->image);
+        }, [request, callback] () {
+            callback(request->success ? request->image.get() : nullptr);
+            if (image_pool.size() < max_pooled_images)
+                image_pool.push_back(std::move(request->image));
+        });
+    }
+
+    void cancel_decode(uint32_t id)
+    {
+        image_worker.cancel(id);
+    }
+
+    texture_t::~texture_t()
+    {
+        cancel_decode(decode_request);
+        if (tex == (GLuint)-1)
+            return;
+
+        OpenGL::render_begin();
+        GL_CALL(glDeleteTextures(1, &tex));
+        OpenGL::render_end();
+    }
+
+    std::shared_ptr<texture_t> get_texture(std::string name, GLenum target)
+    {
+        using key_t = std::tuple<std::string, GLenum, int64_t, int64_t>;
+        static std::map<key_t, std::weak_ptr<texture_t>> textures;
+
+        /* A changed file gets a new entry, users of the old image keep it
+         * until they reload */
+        struct stat st;
+        int64_t mtime_sec = 0, mtime_nsec = 0;
+        if (stat(name.c_str(), &st) == 0)
+        {
+            mtime_sec = st.st_mtim.tv_sec;
+            mtime_nsec = st.st_mtim.tv_nsec;
+        }
+
+        auto& entry = textures[key_t{name, target, mtime_sec, mtime_nsec}];
+        if (auto texture = entry.lock())
+            return texture;
+
+        /* Drop entries of textures which are no longer used */
+        for (auto it = textures.begin(); it != textures.end();)
+        {
+            if (it->second.expired() && &it->second != &entry)
+                it = textures.erase(it);
+            else
+                ++it;
+        }
+
+        auto texture = std::make_shared<texture_t>();
+        texture->target = target;
+        entry = texture;
+
+        OpenGL::render_begin();
+        GL_CALL(glGenTextures(1, &texture->tex));
+        GL_CALL(glBindTexture(target, texture->tex));
+        if (target == GL_TEXTURE_CUBE_MAP)
+        {
+            for (int i = 0; i < 6; i++)
+                upload_placeholder(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
+        } else
+        {
+            upload_placeholder(target);
+        }
+
+        GL_CALL(glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+        GL_CALL(glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+        GL_CALL(glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+        GL_CALL(glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        if (target == GL_TEXTURE_CUBE_MAP)
+        {
+            GL_CALL(glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
         }
+        GL_CALL(glBindTexture(target, 0));
+        OpenGL::render_end();
+
+        /* The texture cancels the request when destroyed */
+        texture_t *raw = texture.get();
+        texture->decode_request = decode_async(name,
+            [raw, name] (const image_t *image)
+        {
+            raw->decode_request = 0;
+            OpenGL::render_begin();
+            if (image)
+            {
+                GL_CALL(glBindTexture(raw->target, raw->tex));
+                if (raw->target == GL_TEXTURE_CUBE_MAP)
+                {
+                    for (int i = 0; i < 6; i++)
+                        upload(*image, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
+                } else
+                {
+                    upload(*image, raw->target);
+                }
+
+                GL_CALL(glBindTexture(raw->target, 0));
+                raw->ready = true;
+            } else
+            {
+                log_error("failed to load texture from \"%s\"", name.c_str());
+                GL_CALL(glDeleteTextures(1, &raw->tex));
+                raw->tex = -1;
+                raw->failed = true;
+            }
+            OpenGL::render_end();
+        });
+
+        return texture;
     }
 
     void write_to_file(std::string name, uint8_t *pixels, int w, int h, std::string type)
@@ -226,12 +626,164 @@ namespace image_io {
         }
     }
 
+    namespace {
+        struct write_request_t
+        {
+            std::string name;
+            std::vector<uint8_t> pixels;
+            int width, height;
+            Writer writer;
+            bool success = false;
+        };
+    }
+
+    void write_to_file_async(std::string name, std::vector<uint8_t> pixels,
+        int w, int h, std::string type, write_callback_t callback)
+    {
+        auto request = std::make_shared<write_request_t>();
+        request->name = std::move(name);
+        request->pixels = std::move(pixels);
+        request->width = w;
+        request->height = h;
+
+        auto it = writers.find(type);
+        if (it == writers.end())
+        {
+            log_error("unsupported image_writer backend");
+        } else
+        {
+            request->writer = it->second;
+        }
+
+        image_worker.submit([request] () {
+            if (request->writer)
+            {
+                request->success = request->writer(request->name.c_str(),
+                    request->pixels.data(), request->width, request->height);
+            }
+        }, [request, callback] () {
+            if (callback)
+                callback(request->success);
+        });
+    }
+
+    namespace {
+        struct pending_capture_t
+        {
+            GLuint pbo;
+            GLsync fence;
+            int width, height;
+            std::string name, type;
+            write_callback_t callback;
+        };
+
+        /* How often to check whether the GPU has finished pending captures */
+        static constexpr int capture_poll_interval_ms = 4;
+
+        std::vector<pending_capture_t> pending_captures;
+        wl_event_source *capture_timer = nullptr;
+
+        int poll_captures(void*)
+        {
+            std::vector<pending_capture_t> failed;
+
+            OpenGL::render_begin();
+            for (auto it = pending_captures.begin(); it != pending_captures.end();)
+            {
+                auto status = GL_CALL(glClientWaitSync(it->fence, 0, 0));
+                if (status == GL_TIMEOUT_EXPIRED)
+                {
+                    ++it;
+                    continue;
+                }
+
+                GL_CALL(glDeleteSync(it->fence));
+
+                size_t size = 4ul * it->width * it->height;
+                std::vector<uint8_t> pixels;
+
+                GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, it->pbo));
+                void *data = nullptr;
+                if (status != GL_WAIT_FAILED)
+                {
+                    data = GL_CALL(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size,
+                            GL_MAP_READ_BIT));
+                }
+
+                if (data)
+                {
+                    pixels.assign((uint8_t*)data, (uint8_t*)data + size);
+                    GL_CALL(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+                }
+
+                GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+                GL_CALL(glDeleteBuffers(1, &it->pbo));
+
+                if (data)
+                {
+                    write_to_file_async(it->name, std::move(pixels), it->width,
+                        it->height, it->type, it->callback);
+                } else
+                {
+                    log_error("failed to read back capture for %s", it->name.c_str());
+                    failed.push_back(std::move(*it));
+                }
+
+                it = pending_captures.erase(it);
+            }
+            OpenGL::render_end();
+
+            if (!pending_captures.empty())
+                wl_event_source_timer_update(capture_timer, capture_poll_interval_ms);
+
+            for (auto& capture : failed)
+            {
+                if (capture.callback)
+                    capture.callback(false);
+            }
+
+            return 0;
+        }
+    }
+
+    void capture_to_file_async(int width, int height, std::string name,
+        std::string type, write_callback_t callback)
+    {
+        pending_capture_t capture;
+        capture.width = width;
+        capture.height = height;
+        capture.name = std::move(name);
+        capture.type = std::move(type);
+        capture.callback = std::move(callback);
+
+        GL_CALL(glGenBuffers(1, &capture.pbo));
+        GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo));
+        GL_CALL(glBufferData(GL_PIXEL_PACK_BUFFER, 4ul * width * height,
+                nullptr, GL_STREAM_READ));
+        GL_CALL(glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0));
+        GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+
+        capture.fence = GL_CALL(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+        /* Make sure the fence will be signaled without waiting on it */
+        GL_CALL(glFlush());
+
+        pending_captures.push_back(std::move(capture));
+        if (!capture_timer)
+        {
+            capture_timer = wl_event_loop_add_timer(wf::get_core().ev_loop,
+                poll_captures, nullptr);
+        }
+
+        wl_event_source_timer_update(capture_timer, capture_poll_interval_ms);
+    }
+
     void init()
     {
         log_debug("init ImageIO");
+        image_worker.init();
 #ifdef BUILD_WITH_IMAGEIO
-        loaders["png"] = Loader(texture_from_png);
-        loaders["jpg"] = Loader(texture_from_jpeg);
+        loaders["png"] = Loader(image_from_png);
+        loaders["jpg"] = Loader(image_from_jpeg);
         writers["png"] = Writer(texture_to_png);
 #endif
     }
@@ -1,12 +1,31 @@
 #include "object.hpp"
 #include "nonstd/safe-list.hpp"
+#include "event-trace.hpp"
+#include "plugin-profiler.hpp"
 #include <unordered_map>
 
+namespace
+{
+    struct signal_connection_t
+    {
+        wf::signal_callback_t *callback;
+        /* The plugin which connected the callback, used for profiling */
+        wf::plugin_profiler::plugin_handle_ptr owner;
+    };
+
+    struct signal_t
+    {
+        wf::safe_list_t<signal_connection_t> connections;
+        /* The name of the signal in the event trace, interned on the first
+         * traced emit */
+        const char *trace_name = nullptr;
+    };
+}
+
 class wf::signal_provider_t::sprovider_impl
 {
   public:
-    std::unordered_map<std::string,
-        wf::safe_list_t<signal_callback_t*>> signals;
+    std::unordered_map<std::string, signal_t> signals;
 };
 
 wf::signal_provider_t::signal_provider_t()
@@ -21,21 +40,31 @@ wf::signal_provider_t::~signal_provider_t()
 void wf::signal_provider_t::connect_signal(std::string name,
     signal_callback_t* callback)
 {
-    sprovider_priv->signals[name].push_back(callback);
+    sprovider_priv->signals[name].connections.push_back(
+        {callback, wf::plugin_profiler::get_current_plugin()});
 }
 
 /* Unregister a registered callback */
 void wf::signal_provider_t::disconnect_signal(std::string name,
     signal_callback_t* callback)
 {
-    sprovider_priv->signals[name].remove_all(callback);
+    sprovider_priv->signals[name].connections.remove_if(
+        [=] (const signal_connection_t& conn) {
+            return conn.callback == callback;
+        });
 }
 
 /* Emit the given signal. No type checking for data is required */
 void wf::signal_provider_t::emit_signal(std::string name, wf::signal_data_t *data)
 {
-    sprovider_priv->signals[name].for_each([data] (auto call) {
-        (*call) (data);
+    auto& signal = sprovider_priv->signals[name];
+    if (wf::event_trace::enabled && !signal.trace_name)
+        signal.trace_name = wf::event_trace::intern("signal " + name);
+
+    wf::event_trace::scope_t trace(signal.trace_name);
+    signal.connections.for_each([data] (auto& conn) {
+        wf::plugin_profiler::scope_t profile(conn.owner);
+        (*conn.callback) (data);
     });
 }
 
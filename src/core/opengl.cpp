@@ -1,4 +1,9 @@
 #include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "opengl-priv.hpp"
 #include "debug.hpp"
 #include "output.hpp"
@@ -93,12 +98,38 @@ namespace OpenGL
         return compile_shader(str.c_str(), type);
     }
 
+    namespace
+    {
+        /* The number of program binary formats, -1 until it is queried */
+        GLint num_binary_formats = -1;
+
+        /* Whether linked programs can be retrieved and loaded as binaries */
+        bool supports_program_binaries()
+        {
+            if (num_binary_formats < 0)
+            {
+                /* Stays 0 if the query fails, so it isn't repeated */
+                num_binary_formats = 0;
+                GL_CALL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS,
+                        &num_binary_formats));
+            }
+
+            return num_binary_formats > 0;
+        }
+    }
+
     GLuint create_program_from_shaders(GLuint vertex_shader,
         GLuint fragment_shader)
     {
         auto result_program = GL_CALL(glCreateProgram());
         GL_CALL(glAttachShader(result_program, vertex_shader));
         GL_CALL(glAttachShader(result_program, fragment_shader));
+        /* Allow the program to be stored in the program cache */
+        if (supports_program_binaries())
+        {
+            GL_CALL(glProgramParameteri(result_program,
+                    GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+        }
         GL_CALL(glLinkProgram(result_program));
 
         /* won't be really deleted until program is deleted as well */
@@ -108,23 +139,309 @@ namespace OpenGL
         return result_program;
     }
 
+    namespace
+    {
+        /**
+         * Caches the binaries of linked programs, so that the same shaders
+         * aren't compiled again when plugins are reloaded, or, with the disk
+         * cache, when the compositor is restarted.
+         *
+         * Binaries are kept instead of the programs themselves, because each
+         * caller owns (and eventually deletes) the program it gets.
+         */
+        struct program_cache_t
+        {
+            struct entry_t
+            {
+                std::string vertex_source, frag_source;
+                GLenum format;
+                std::vector<char> binary;
+            };
+
+            static constexpr uint32_t file_magic = 0x43535746; // "WFSC"
+            static constexpr uint32_t file_version = 1;
+
+            bool use_disk_cache = true;
+            std::unordered_map<size_t, entry_t> entries;
+
+            /* Binaries are valid only for the driver which created them */
+            std::string get_driver_id()
+            {
+                std::string id;
+                for (auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+                {
+                    auto str = GL_CALL(glGetString(name));
+                    id += str ? (const char*)str : "";
+                    id += '\n';
+                }
+
+                return id;
+            }
+
+            bool supports_binaries()
+            {
+                return supports_program_binaries();
+            }
+
+            std::string get_cache_dir()
+            {
+                std::string dir;
+                const char *xdg_cache = getenv("XDG_CACHE_HOME");
+                const char *home = getenv("HOME");
+                if (xdg_cache && *xdg_cache)
+                {
+                    dir = xdg_cache;
+                } else if (home)
+                {
+                    dir = std::string(home) + "/.cache";
+                } else
+                {
+                    return "";
+                }
+
+                return dir + "/wayfire/shaders";
+            }
+
+            std::string get_cache_file(size_t key)
+            {
+                auto dir = get_cache_dir();
+                if (dir.empty())
+                    return "";
+
+                char name[32];
+                snprintf(name, sizeof(name), "/%016zx.bin", key);
+                return dir + name;
+            }
+
+            static void write_string(std::ostream& out, const char *data,
+                uint32_t size)
+            {
+                out.write((const char*)&size, sizeof(size));
+                out.write(data, size);
+            }
+
+            template<class T> static bool read_string(std::istream& in, T& str)
+            {
+                uint32_t size;
+                if (!in.read((char*)&size, sizeof(size)) || size > (1u << 26))
+                    return false;
+
+                str.resize(size);
+                return size == 0 || in.read(&str[0], size);
+            }
+
+            bool load_from_disk(size_t key, entry_t& entry)
+            {
+                auto path = get_cache_file(key);
+                if (path.empty())
+                    return false;
+
+                std::ifstream in(path, std::ios::binary);
+                if (!in.is_open())
+                    return false;
+
+                uint32_t magic, version;
+                std::string driver_id;
+                in.read((char*)&magic, sizeof(magic));
+                in.read((char*)&version, sizeof(version));
+                if (!in || magic != file_magic || version != file_version)
+                    return false;
+
+                if (!read_string(in, driver_id) || driver_id != get_driver_id())
+                    return false;
+
+                return read_string(in, entry.vertex_source) &&
+                    read_string(in, entry.frag_source) &&
+                    in.read((char*)&entry.format, sizeof(entry.format)) &&
+                    read_string(in, entry.binary);
+            }
+
+            void save_to_disk(size_t key, const entry_t& entry)
+            {
+                auto dir = get_cache_dir();
+                if (dir.empty())
+                    return;
+
+                /* Create all missing parents of the cache directory */
+                for (size_t pos = dir.find('/', 1); ; pos = dir.find('/', pos + 1))
+                {
+                    mkdir(dir.substr(0, pos).c_str(), 0700);
+                    if (pos == std::string::npos)
+                        break;
+                }
+
+                /* Write to a temporary file first, so that a crash doesn't
+                 * leave a truncated binary behind */
+                auto path = get_cache_file(key);
+                auto tmp_path = path + ".tmp";
+                {
+                    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+                    if (!out.is_open())
+                        return;
+
+                    auto driver_id = get_driver_id();
+                    /* Copies, because the static constexpr members have no
+                     * definition in C++14 and can't be ODR-used */
+                    uint32_t magic = file_magic, version = file_version;
+                    out.write((const char*)&magic, sizeof(magic));
+                    out.write((const char*)&version, sizeof(version));
+                    write_string(out, driver_id.data(), driver_id.size());
+                    write_string(out, entry.vertex_source.data(),
+                        entry.vertex_source.size());
+                    write_string(out, entry.frag_source.data(),
+                        entry.frag_source.size());
+                    out.write((const char*)&entry.format, sizeof(entry.format));
+                    write_string(out, entry.binary.data(), entry.binary.size());
+
+                    if (!out)
+                    {
+                        out.close();
+                        unlink(tmp_path.c_str());
+                        return;
+                    }
+                }
+
+                if (rename(tmp_path.c_str(), path.c_str()) != 0)
+                    unlink(tmp_path.c_str());
+            }
+
+            /* Create a program from a cached binary, or return -1 if the
+             * binary is rejected, for ex. after a driver update */
+            GLuint create_from_binary(const entry_t& entry)
+            {
+                auto program = GL_CALL(glCreateProgram());
+                GL_CALL(glProgramBinary(program, entry.format,
+                        entry.binary.data(), entry.binary.size()));
+
+                GLint status = GL_FALSE;
+                GL_CALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+                if (status != GL_TRUE)
+                {
+                    GL_CALL(glDeleteProgram(program));
+                    return -1;
+                }
+
+                return program;
+            }
+
+            /* Store the binary of a freshly linked program */
+            void store(size_t key, const std::string& vertex_source,
+                const std::string& frag_source, GLuint program)
+            {
+                GLint status = GL_FALSE, length = 0;
+                GL_CALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+                GL_CALL(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+                if (status != GL_TRUE || length <= 0)
+                    return;
+
+                entry_t entry;
+                entry.vertex_source = vertex_source;
+                entry.frag_source = frag_source;
+                entry.binary.resize(length);
+                GL_CALL(glGetProgramBinary(program, length, NULL, &entry.format,
+                        entry.binary.data()));
+
+                if (use_disk_cache)
+                    save_to_disk(key, entry);
+
+                entries[key] = std::move(entry);
+            }
+
+            GLuint find(size_t key, const std::string& vertex_source,
+                const std::string& frag_source)
+            {
+                auto it = entries.find(key);
+                if (it == entries.end() && use_disk_cache)
+                {
+                    entry_t entry;
+                    if (load_from_disk(key, entry))
+                        it = entries.emplace(key, std::move(entry)).first;
+                }
+
+                /* Guard against hash collisions */
+                if (it == entries.end() ||
+                    it->second.vertex_source != vertex_source ||
+                    it->second.frag_source != frag_source)
+                {
+                    return -1;
+                }
+
+                auto program = create_from_binary(it->second);
+                if (program == (GLuint)-1)
+                    entries.erase(it);
+
+                return program;
+            }
+        } program_cache;
+
+        GLuint create_cached_program(const std::string& vertex_source,
+            const std::string& frag_source, std::string vertex_path,
+            std::string frag_path)
+        {
+            bool cacheable = program_cache.supports_binaries();
+            size_t key = std::hash<std::string>{}(vertex_source + '\0' + frag_source);
+
+            if (cacheable)
+            {
+                auto program = program_cache.find(key, vertex_source, frag_source);
+                if (program != (GLuint)-1)
+                    return program;
+            }
+
+            auto program = create_program_from_shaders(
+                compile_shader_from_file(vertex_path, vertex_source, GL_VERTEX_SHADER),
+                compile_shader_from_file(frag_path, frag_source, GL_FRAGMENT_SHADER));
+
+            if (cacheable)
+                program_cache.store(key, vertex_source, frag_source, program);
+
+            return program;
+        }
+
+        bool read_shader_file(std::string path, std::string& source)
+        {
+            std::fstream file(path, std::ios::in);
+            if(!file.is_open())
+            {
+                log_error("cannot open shader file %s", path.c_str());
+                return false;
+            }
+
+            std::string line;
+            while(std::getline(file, line))
+                source += line, source += '\n';
+
+            return true;
+        }
+    }
+
     GLuint create_program_from_source(std::string vertex_source,
         std::string frag_source)
     {
-        return create_program_from_shaders(
-            compile_shader(vertex_source, GL_VERTEX_SHADER),
-            compile_shader(frag_source, GL_FRAGMENT_SHADER));
+        return create_cached_program(vertex_source, frag_source,
+            "internal", "internal");
     }
 
     GLuint create_program(std::string vertex_path, std::string frag_path)
     {
-        return create_program_from_shaders(
-            load_shader(vertex_path, GL_VERTEX_SHADER),
-            load_shader(frag_path, GL_FRAGMENT_SHADER));
+        std::string vertex_source, frag_source;
+        if (!read_shader_file(vertex_path, vertex_source) ||
+            !read_shader_file(frag_path, frag_source))
+        {
+            /* Same result as linking the shaders which failed to load */
+            return create_program_from_shaders(-1, -1);
+        }
+
+        return create_cached_program(vertex_source, frag_source,
+            vertex_path, frag_path);
     }
 
     void init()
     {
+        auto section = wf::get_core().config->get_section("core");
+        program_cache.use_disk_cache =
+            section->get_option("shader_cache", "1")->as_int();
+
         render_begin();
 
         // enable_gl_synchronuous_debug()
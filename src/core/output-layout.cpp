@@ -8,6 +8,7 @@
 #include "util.hpp"
 #include "../output/output-impl.hpp"
 #include <xf86drmMode.h>
+#include <sys/stat.h>
 #include <sstream>
 #include <cstring>
 #include <unordered_set>
@@ -261,6 +262,11 @@ namespace wf
             }
         }
 
+        ~output_layout_output_t()
+        {
+            clear_mirror_textures();
+        }
+
         /**
          * Update the current configuration based on the mode set by the
          * backend.
@@ -579,12 +585,144 @@ namespace wf
 
             /* We export the output to mirror from to a dmabuf, then create
              * a texture from this and use it to render "our" output */
-            auto texture = wlr_texture_from_dmabuf(
-                get_core().renderer, &attributes);
+            auto texture = get_mirror_texture(attributes);
+            wlr_dmabuf_attributes_finish(&attributes);
+
+            if (!texture)
+            {
+                log_error("Failed importing mirrored output contents");
+                return;
+            }
+
             render_output(texture);
+        }
 
-            wlr_texture_destroy(texture);
-            wlr_dmabuf_attributes_finish(&attributes);
+        /**
+         * The mirrored output cycles through a small set of buffers, so
+         * instead of importing the exported buffer on every frame, we keep
+         * the texture of each buffer we have seen and reuse it when the same
+         * buffer comes again. Buffers are identified by the device and inode
+         * of the dmabuf of each plane, which are the same for every export of
+         * the same buffer, together with the layout of the planes.
+         */
+        struct mirror_buffer_key_t
+        {
+            int32_t width, height;
+            uint32_t format, flags;
+            uint64_t modifier;
+            int n_planes;
+            dev_t device[WLR_DMABUF_MAX_PLANES];
+            ino_t inode[WLR_DMABUF_MAX_PLANES];
+            uint32_t offset[WLR_DMABUF_MAX_PLANES];
+            uint32_t stride[WLR_DMABUF_MAX_PLANES];
+
+            bool operator == (const mirror_buffer_key_t& other) const
+            {
+                if (width != other.width || height != other.height ||
+                    format != other.format || flags != other.flags ||
+                    modifier != other.modifier || n_planes != other.n_planes)
+                {
+                    return false;
+                }
+
+                for (int i = 0; i < n_planes; i++)
+                {
+                    if (device[i] != other.device[i] ||
+                        inode[i] != other.inode[i] ||
+                        offset[i] != other.offset[i] ||
+                        stride[i] != other.stride[i])
+                    {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+        };
+
+        struct mirror_texture_t
+        {
+            mirror_buffer_key_t key;
+            wlr_texture *texture;
+        };
+
+        /**
+         * Fill the key identifying the buffer of the given attributes.
+         *
+         * @return false if the buffer couldn't be identified
+         */
+        bool get_mirror_buffer_key(const wlr_dmabuf_attributes& attributes,
+            mirror_buffer_key_t& key)
+        {
+            key.width = attributes.width;
+            key.height = attributes.height;
+            key.format = attributes.format;
+            key.flags = attributes.flags;
+            key.modifier = attributes.modifier;
+            key.n_planes = attributes.n_planes;
+
+            for (int i = 0; i < attributes.n_planes; i++)
+            {
+                struct stat buffer_stat;
+                if (fstat(attributes.fd[i], &buffer_stat) != 0)
+                    return false;
+
+                key.device[i] = buffer_stat.st_dev;
+                key.inode[i] = buffer_stat.st_ino;
+                key.offset[i] = attributes.offset[i];
+                key.stride[i] = attributes.stride[i];
+            }
+
+            return true;
+        }
+
+        /* Most recently used last */
+        std::vector<mirror_texture_t> mirror_textures;
+        static constexpr size_t max_mirror_textures = 4;
+
+        wlr_texture *get_mirror_texture(const wlr_dmabuf_attributes& attributes)
+        {
+            /* If we cannot identify the buffer, its texture is never reused,
+             * and is destroyed when evicted like the others */
+            mirror_buffer_key_t key;
+            bool identified = get_mirror_buffer_key(attributes, key);
+
+            for (auto it = mirror_textures.begin();
+                 it != mirror_textures.end() && identified; ++it)
+            {
+                if (it->key == key)
+                {
+                    auto cached = *it;
+                    mirror_textures.erase(it);
+                    mirror_textures.push_back(cached);
+                    return cached.texture;
+                }
+            }
+
+            auto texture = wlr_texture_from_dmabuf(get_core().renderer,
+                const_cast<wlr_dmabuf_attributes*> (&attributes));
+            if (!texture)
+                return nullptr;
+
+            if (mirror_textures.size() >= max_mirror_textures)
+            {
+                wlr_texture_destroy(mirror_textures.front().texture);
+                mirror_textures.erase(mirror_textures.begin());
+            }
+
+            if (!identified)
+                key.n_planes = -1;
+
+            mirror_textures.push_back({key, texture});
+
+            return texture;
+        }
+
+        void clear_mirror_textures()
+        {
+            for (auto& mt : mirror_textures)
+                wlr_texture_destroy(mt.texture);
+            mirror_textures.clear();
         }
 
         void setup_mirror()
@@ -631,6 +769,7 @@ namespace wf
         {
             on_mirrored_frame.disconnect();
             on_frame.disconnect();
+            clear_mirror_textures();
         }
 
         /** Apply the given state to the output, ignoring position.
@@ -721,7 +860,18 @@ namespace wf
 
             output_layout = wlr_output_layout_create();
 
-            on_config_reload = [=] (void*) { reconfigure_from_config(); };
+            on_config_reload = [=] (signal_data_t *data)
+            {
+                /* Each output is configured by the section with its name */
+                for (auto& entry : outputs)
+                {
+                    if (config_section_changed(data, entry.first->name))
+                    {
+                        reconfigure_from_config();
+                        return;
+                    }
+                }
+            };
             get_core().connect_signal("reload-config", &on_config_reload);
             on_shutdown = [=] (void*) {
                 shutdown_received = true;
@@ -0,0 +1,206 @@
+#include "plugin-profiler.hpp"
+#include "gpu-profiler.hpp"
+#include "plugin.hpp"
+#include "debug.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <ctime>
+
+namespace
+{
+    constexpr int64_t report_period_us = 1000000;
+
+    struct plugin_stats_t
+    {
+        /* CPU time in the frame which is being built */
+        int64_t frame_us = 0;
+        int64_t total_us = 0;
+        int64_t max_us = 0;
+    };
+
+    struct profiler_state_t
+    {
+        int enable_counter = 0;
+
+        wf::plugin_profiler::plugin_handle_ptr current;
+        /* When the current plugin was last entered or resumed */
+        int64_t last_switch_us = 0;
+
+        std::unordered_map<std::string, plugin_stats_t> stats;
+        int64_t period_start_us = -1;
+        int period_frames = 0;
+
+        std::vector<wf::plugin_profiler::plugin_cost_t> last_report;
+
+        /* The handles of the plugin instances which are still alive */
+        std::unordered_map<wf::plugin_grab_interface_t*,
+            wf::plugin_profiler::plugin_handle_ptr> handles;
+    } profiler;
+
+    int64_t get_time_us()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec * 1000000ll + now.tv_nsec / 1000ll;
+    }
+
+    /* Charge the time since the last switch to the current plugin */
+    void switch_plugin(const wf::plugin_profiler::plugin_handle_ptr& next)
+    {
+        if (profiler.enable_counter)
+        {
+            int64_t now = get_time_us();
+            if (profiler.current)
+            {
+                profiler.stats[profiler.current->get_name()].frame_us +=
+                    now - profiler.last_switch_us;
+            }
+
+            profiler.last_switch_us = now;
+
+            static const std::string core_name;
+            wf::gpu_profiler::plugin_switched(
+                profiler.current ? profiler.current->get_name() : core_name);
+        }
+
+        profiler.current = next;
+    }
+
+    void make_report(int64_t now)
+    {
+        auto& report = profiler.last_report;
+        report.clear();
+
+        for (auto& entry : profiler.stats)
+        {
+            wf::plugin_profiler::plugin_cost_t cost;
+            cost.name = entry.first.empty() ? "unnamed" : entry.first;
+            cost.cpu_avg_ms = entry.second.total_us / 1000.0 /
+                std::max(profiler.period_frames, 1);
+            cost.cpu_max_ms = entry.second.max_us / 1000.0;
+            report.push_back(cost);
+        }
+
+        std::sort(report.begin(), report.end(), [] (auto& a, auto& b) {
+            return a.cpu_avg_ms > b.cpu_avg_ms;
+        });
+
+        /* Plugins which did nothing don't show up in the next report */
+        profiler.stats.clear();
+        profiler.period_start_us = now;
+        profiler.period_frames = 0;
+    }
+}
+
+namespace wf
+{
+namespace plugin_profiler
+{
+plugin_handle_t::plugin_handle_t(plugin_grab_interface_t *plugin)
+    : plugin(plugin)
+{
+}
+
+const std::string& plugin_handle_t::get_name() const
+{
+    return plugin ? plugin->name : name;
+}
+
+void set_enabled(bool enabled)
+{
+    profiler.enable_counter += enabled ? 1 : -1;
+    if (profiler.enable_counter < 0)
+    {
+        log_error("plugin profiler enable counter got below 0!");
+        profiler.enable_counter = 0;
+    }
+
+    if (enabled && profiler.enable_counter == 1)
+    {
+        profiler.last_switch_us = get_time_us();
+        profiler.period_start_us = -1;
+        profiler.period_frames = 0;
+        profiler.stats.clear();
+        profiler.last_report.clear();
+    }
+}
+
+bool is_enabled()
+{
+    return profiler.enable_counter > 0;
+}
+
+std::vector<plugin_cost_t> get_plugin_costs()
+{
+    auto costs = profiler.last_report;
+    for (auto& cost : costs)
+        cost.gpu_avg_ms = gpu_profiler::get_plugin_gpu_ms(cost.name);
+
+    return costs;
+}
+
+plugin_handle_ptr get_current_plugin()
+{
+    return profiler.current;
+}
+
+plugin_handle_ptr get_handle(plugin_grab_interface_t *plugin)
+{
+    auto& handle = profiler.handles[plugin];
+    if (!handle)
+        handle = std::make_shared<plugin_handle_t>(plugin);
+
+    return handle;
+}
+
+void plugin_destroyed(plugin_grab_interface_t *plugin)
+{
+    auto it = profiler.handles.find(plugin);
+    if (it == profiler.handles.end())
+        return;
+
+    it->second->name = plugin->name;
+    it->second->plugin = nullptr;
+    profiler.handles.erase(it);
+}
+
+scope_t::scope_t(const plugin_handle_ptr& plugin)
+{
+    if (!plugin)
+        return;
+
+    active = true;
+    previous = profiler.current;
+    switch_plugin(plugin);
+}
+
+scope_t::~scope_t()
+{
+    if (active)
+        switch_plugin(previous);
+}
+
+void frame_done()
+{
+    if (!profiler.enable_counter)
+        return;
+
+    for (auto& entry : profiler.stats)
+    {
+        auto& stats = entry.second;
+        stats.total_us += stats.frame_us;
+        stats.max_us = std::max(stats.max_us, stats.frame_us);
+        stats.frame_us = 0;
+    }
+
+    int64_t now = get_time_us();
+    if (profiler.period_start_us < 0)
+        profiler.period_start_us = now;
+
+    ++profiler.period_frames;
+    if (now - profiler.period_start_us >= report_period_us)
+        make_report(now);
+}
+}
+}
@@ -65,3 +65,10 @@ wf::output_t *get_signaled_output(wf::signal_data_t *data)
     return result ? result->output : nullptr;
 }
 
+bool wf::config_section_changed(wf::signal_data_t *data,
+    const std::string& section)
+{
+    auto ev = static_cast<wf::reload_config_signal*> (data);
+    return !ev || ev->changed_sections.count(section);
+}
+
@@ -8,6 +8,7 @@
 #include "output-layout.hpp"
 #include "tablet.hpp"
 #include "signal-definitions.hpp"
+#include "../event-trace.hpp"
 
 extern "C" {
 #include <wlr/util/region.h>
@@ -28,8 +29,9 @@ wf_cursor::wf_cursor()
     setup_listeners();
     init_xcursor();
 
-    config_reloaded = [=] (wf::signal_data_t*) {
-        init_xcursor();
+    config_reloaded = [=] (wf::signal_data_t *data) {
+        if (wf::config_section_changed(data, "input"))
+            init_xcursor();
     };
 
     wf::get_core().connect_signal("reload-config", &config_reloaded);
@@ -41,6 +43,7 @@ void wf_cursor::setup_listeners()
 
     /* Dispatch pointer events to the LogicalPointer */
     on_frame.set_callback([&] (void *) {
+        wf::event_trace::scope_t trace("pointer frame");
         core.input->lpointer->handle_pointer_frame();
         wlr_idle_notify_activity(core.protocols.idle,
             core.get_current_seat());
@@ -50,6 +53,7 @@ void wf_cursor::setup_listeners()
 #define setup_passthrough_callback(evname) \
     on_##evname.set_callback([&] (void *data) { \
         auto ev = static_cast<wlr_event_pointer_##evname *> (data); \
+        wf::event_trace::scope_t trace("pointer " #evname); \
         emit_device_event_signal("pointer_" #evname, ev); \
         core.input->lpointer->handle_pointer_##evname (ev); \
         wlr_idle_notify_activity(core.protocols.idle, core.get_current_seat()); \
@@ -75,6 +79,7 @@ void wf_cursor::setup_listeners()
 #define setup_tablet_callback(evname) \
     on_tablet_##evname.set_callback([&] (void *data) { \
         auto ev = static_cast<wlr_event_tablet_tool_##evname *> (data); \
+        wf::event_trace::scope_t trace("tablet " #evname); \
         emit_device_event_signal("tablet_" #evname, ev); \
         if (ev->device->tablet->data) { \
             auto tablet = \
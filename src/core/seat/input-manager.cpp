@@ -166,8 +166,11 @@ input_manager::input_manager()
     wf::get_core().connect_signal("_surface_mapped", &surface_map_state_changed);
     wf::get_core().connect_signal("_surface_unmapped", &surface_map_state_changed);
 
-    config_updated = [=] (wf::signal_data_t *)
+    config_updated = [=] (wf::signal_data_t *data)
     {
+        if (!wf::config_section_changed(data, "input"))
+            return;
+
         for (auto& dev : input_devices)
             dev->update_options();
         for (auto& kbd : keyboards)
@@ -323,6 +326,7 @@ wf_binding* input_manager::new_binding(wf_binding_type type, wf_option value,
     binding->type = type;
     binding->value = value;
     binding->output = output;
+    binding->owner = wf::plugin_profiler::get_current_plugin();
     binding->call.raw = callback;
 
     auto raw = binding.get();
@@ -380,7 +384,9 @@ bool input_manager::check_button_bindings(uint32_t button)
             /* We must be careful because the callback might be erased,
              * so force copy the callback into the lambda */
             auto callback = binding->call.button;
+            auto owner = binding->owner;
             callbacks.push_back([=] () {
+                wf::plugin_profiler::scope_t profile(owner);
                 return (*callback) (button, oc.x, oc.y);
             });
         }
@@ -394,7 +400,9 @@ bool input_manager::check_button_bindings(uint32_t button)
             /* We must be careful because the callback might be erased,
              * so force copy the callback into the lambda */
             auto callback = binding->call.activator;
+            auto owner = binding->owner;
             callbacks.push_back([=] () {
+                wf::plugin_profiler::scope_t profile(owner);
                 return (*callback) (ACTIVATOR_SOURCE_BUTTONBINDING, button);
             });
         }
@@ -409,18 +417,22 @@ bool input_manager::check_button_bindings(uint32_t button)
 
 bool input_manager::check_axis_bindings(wlr_event_pointer_axis *ev)
 {
-    std::vector<axis_callback*> callbacks;
+    std::vector<std::pair<axis_callback*,
+        wf::plugin_profiler::plugin_handle_ptr>> callbacks;
     auto mod_state = get_modifiers();
 
     for (auto& binding : bindings[WF_BINDING_AXIS])
     {
         if (binding->output == wf::get_core().get_active_output() &&
             binding->value->as_cached_key().matches({mod_state, 0}))
-            callbacks.push_back(binding->call.axis);
+            callbacks.push_back({binding->call.axis, binding->owner});
     }
 
-    for (auto call : callbacks)
-        (*call) (ev);
+    for (auto& call : callbacks)
+    {
+        wf::plugin_profiler::scope_t profile(call.second);
+        (*call.first) (ev);
+    }
 
     return !callbacks.empty();
 }
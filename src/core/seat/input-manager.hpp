@@ -9,6 +9,7 @@
 #include "cursor.hpp"
 #include "pointer.hpp"
 #include "plugin.hpp"
+#include "plugin-profiler.hpp"
 #include "view.hpp"
 #include "core.hpp"
 #include "signal-definitions.hpp"
@@ -42,6 +43,8 @@ struct wf_binding
     wf_option value;
     wf_binding_type type;
     wf::output_t *output;
+    /* The plugin which added the binding, used for profiling */
+    wf::plugin_profiler::plugin_handle_ptr owner;
 
     union {
         void *raw;
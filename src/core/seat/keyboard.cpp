@@ -9,6 +9,7 @@ extern "C"
 
 #include "keyboard.hpp"
 #include "../core-impl.hpp"
+#include "../event-trace.hpp"
 #include "../../output/output-impl.hpp"
 #include "cursor.hpp"
 #include "touch.hpp"
@@ -21,6 +22,7 @@ void wf_keyboard::setup_listeners()
     on_key.set_callback([&] (void *data)
     {
         auto ev = static_cast<wlr_event_keyboard_key*> (data);
+        wf::event_trace::scope_t trace("keyboard key");
         emit_device_event_signal("keyboard_key", ev);
 
         auto seat = wf::get_core().get_current_seat();
@@ -190,7 +192,9 @@ std::vector<std::function<bool()>> input_manager::match_keys(uint32_t mod_state,
             /* We must be careful because the callback might be erased,
              * so force copy the callback into the lambda */
             auto callback = binding->call.key;
-            callbacks.push_back([actual_key, callback] () {
+            auto owner = binding->owner;
+            callbacks.push_back([actual_key, callback, owner] () {
+                wf::plugin_profiler::scope_t profile(owner);
                 return (*callback) (actual_key);
             });
         }
@@ -206,7 +210,9 @@ std::vector<std::function<bool()>> input_manager::match_keys(uint32_t mod_state,
              *
              * Also, do not send keys for modifier bindings */
             auto callback = binding->call.activator;
+            auto owner = binding->owner;
             callbacks.push_back([=] () {
+                wf::plugin_profiler::scope_t profile(owner);
                 return (*callback) (ACTIVATOR_SOURCE_KEYBINDING,
                     mod_from_key(seat, actual_key) ? 0 : actual_key);
             });
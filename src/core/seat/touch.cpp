@@ -4,6 +4,7 @@
 #include "touch.hpp"
 #include "input-manager.hpp"
 #include "../core-impl.hpp"
+#include "../event-trace.hpp"
 #include "output.hpp"
 #include "workspace-manager.hpp"
 #include "compositor-surface.hpp"
@@ -235,6 +236,7 @@ wf_touch::wf_touch(wlr_cursor *cursor)
     on_down.set_callback([&] (void *data)
     {
         auto ev = static_cast<wlr_event_touch_down*> (data);
+        wf::event_trace::scope_t trace("touch down");
         emit_device_event_signal("touch_down", &ev);
 
         double lx, ly;
@@ -253,6 +255,7 @@ wf_touch::wf_touch(wlr_cursor *cursor)
     on_up.set_callback([&] (void *data)
     {
         auto ev = static_cast<wlr_event_touch_up*> (data);
+        wf::event_trace::scope_t trace("touch up");
         emit_device_event_signal("touch_up", ev);
         gesture_recognizer.unregister_touch(ev->time_msec, ev->touch_id);
 
@@ -263,6 +266,7 @@ wf_touch::wf_touch(wlr_cursor *cursor)
     on_motion.set_callback([&] (void *data)
     {
         auto ev = static_cast<wlr_event_touch_motion*> (data);
+        wf::event_trace::scope_t trace("touch motion");
         emit_device_event_signal("touch_motion", &ev);
 
         auto touch = static_cast<wf_touch*> (ev->device->data);
@@ -446,18 +450,22 @@ void input_manager::handle_touch_motion(uint32_t time, int32_t id,
 void input_manager::check_touch_bindings(int x, int y)
 {
     uint32_t mods = get_modifiers();
-    std::vector<touch_callback*> calls;
+    std::vector<std::pair<touch_callback*,
+        wf::plugin_profiler::plugin_handle_ptr>> calls;
     for (auto& binding : bindings[WF_BINDING_TOUCH])
     {
         if (binding->value->as_cached_key().matches({mods, 0}) &&
             binding->output == wf::get_core().get_active_output())
         {
-            calls.push_back(binding->call.touch);
+            calls.push_back({binding->call.touch, binding->owner});
         }
     }
 
-    for (auto call : calls)
-        (*call)(x, y);
+    for (auto& call : calls)
+    {
+        wf::plugin_profiler::scope_t profile(call.second);
+        (*call.first)(x, y);
+    }
 }
 
 void input_manager::handle_gesture(wf_touch_gesture g)
@@ -472,7 +480,9 @@ void input_manager::handle_gesture(wf_touch_gesture g)
             /* We must be careful because the callback might be erased,
              * so force copy the callback into the lambda */
             auto call = binding->call.gesture;
+            auto owner = binding->owner;
             callbacks.push_back([=, &g] () {
+                wf::plugin_profiler::scope_t profile(owner);
                 (*call) (&g);
             });
         }
@@ -486,7 +496,9 @@ void input_manager::handle_gesture(wf_touch_gesture g)
             /* We must be careful because the callback might be erased,
              * so force copy the callback into the lambda */
             auto call = binding->call.activator;
+            auto owner = binding->owner;
             callbacks.push_back([=] () {
+                wf::plugin_profiler::scope_t profile(owner);
                 (*call) (ACTIVATOR_SOURCE_GESTURE, 0);
             });
         }
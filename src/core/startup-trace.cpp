@@ -0,0 +1,181 @@
+#include "startup-trace.hpp"
+#include "debug.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+
+namespace
+{
+    struct stage_t
+    {
+        std::string name;
+        int64_t start_us;
+        /* -1 for instant events */
+        int64_t duration_us;
+        int depth;
+    };
+
+    struct trace_state_t
+    {
+        bool enabled = false;
+        /* Where to write the JSON trace, empty for just the summary */
+        std::string path;
+
+        timespec start;
+        int depth = 0;
+        std::vector<stage_t> stages;
+    } trace;
+
+    int64_t elapsed_us()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return (now.tv_sec - trace.start.tv_sec) * 1000000ll +
+            (now.tv_nsec - trace.start.tv_nsec) / 1000ll;
+    }
+
+    std::string escape_json(const std::string& str)
+    {
+        std::string result;
+        for (char c : str)
+        {
+            if (c == '"' || c == '\\')
+            {
+                result += '\\';
+                result += c;
+            } else if ((unsigned char)c < 0x20)
+            {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                result += buf;
+            } else
+            {
+                result += c;
+            }
+        }
+
+        return result;
+    }
+
+    void write_json()
+    {
+        auto file = std::fopen(trace.path.c_str(), "w");
+        if (!file)
+        {
+            log_error("startup trace: failed to open %s", trace.path.c_str());
+            return;
+        }
+
+        int pid = getpid();
+        std::fprintf(file, "{\"traceEvents\":[\n");
+        for (size_t i = 0; i < trace.stages.size(); i++)
+        {
+            const auto& stage = trace.stages[i];
+            if (stage.duration_us < 0)
+            {
+                /* Instant event, i.e the first frame */
+                std::fprintf(file, "{\"name\":\"%s\",\"cat\":\"startup\","
+                    "\"ph\":\"i\",\"s\":\"g\",\"ts\":%ld,\"pid\":%d,\"tid\":%d}",
+                    escape_json(stage.name).c_str(), (long)stage.start_us,
+                    pid, pid);
+            } else
+            {
+                std::fprintf(file, "{\"name\":\"%s\",\"cat\":\"startup\","
+                    "\"ph\":\"X\",\"ts\":%ld,\"dur\":%ld,\"pid\":%d,\"tid\":%d}",
+                    escape_json(stage.name).c_str(), (long)stage.start_us,
+                    (long)stage.duration_us, pid, pid);
+            }
+
+            std::fprintf(file, i + 1 < trace.stages.size() ? ",\n" : "\n");
+        }
+
+        std::fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+        std::fclose(file);
+
+        log_info("startup trace written to %s", trace.path.c_str());
+    }
+
+    void print_summary()
+    {
+        for (const auto& stage : trace.stages)
+        {
+            std::string indent(2 * stage.depth, ' ');
+            if (stage.duration_us < 0)
+            {
+                log_info("startup: %s%s at %.2fms", indent.c_str(),
+                    stage.name.c_str(), stage.start_us / 1000.0);
+            } else
+            {
+                log_info("startup: %s%s: %.2fms (at %.2fms)", indent.c_str(),
+                    stage.name.c_str(), stage.duration_us / 1000.0,
+                    stage.start_us / 1000.0);
+            }
+        }
+    }
+}
+
+namespace wf
+{
+namespace startup_trace
+{
+void init()
+{
+    auto env = getenv("WAYFIRE_STARTUP_TRACE");
+    if (!env || !*env)
+        return;
+
+    trace.enabled = true;
+    if (std::string(env) != "1")
+        trace.path = env;
+
+    clock_gettime(CLOCK_MONOTONIC, &trace.start);
+}
+
+bool is_enabled()
+{
+    return trace.enabled;
+}
+
+scope_t::scope_t(const std::string& name)
+{
+    if (!trace.enabled)
+        return;
+
+    index = trace.stages.size();
+    trace.stages.push_back({name, elapsed_us(), 0, trace.depth});
+    ++trace.depth;
+}
+
+scope_t::~scope_t()
+{
+    /* The trace might have finished while the scope was running */
+    if (!trace.enabled || index < 0)
+        return;
+
+    auto& stage = trace.stages[index];
+    stage.duration_us = elapsed_us() - stage.start_us;
+    --trace.depth;
+}
+
+void first_frame(const std::string& output_name)
+{
+    if (!trace.enabled)
+        return;
+
+    trace.stages.push_back({"first frame on " + output_name,
+        elapsed_us(), -1, trace.depth});
+    trace.enabled = false;
+
+    print_summary();
+    if (!trace.path.empty())
+        write_json();
+
+    trace.stages.clear();
+}
+}
+}
@@ -0,0 +1,52 @@
+#ifndef WF_STARTUP_TRACE_HPP
+#define WF_STARTUP_TRACE_HPP
+
+#include <string>
+#include <cstddef>
+
+/**
+ * Timing of the stages of compositor startup, up to the first frame.
+ *
+ * Enabled by setting WAYFIRE_STARTUP_TRACE. When the first frame has been
+ * submitted, a summary of the stages is printed to the log and, unless the
+ * variable is set to 1, the stages are also written to the file it names as
+ * a Chrome trace-event JSON, which can be opened in chrome://tracing or
+ * Perfetto.
+ */
+namespace wf
+{
+namespace startup_trace
+{
+/** Read the environment and start the clock. Called first thing in main() */
+void init();
+
+/** Whether startup is still being traced */
+bool is_enabled();
+
+/**
+ * Measures the time from its creation to its destruction as a single stage.
+ * Stages may be nested. No-op if tracing is disabled or has finished.
+ */
+class scope_t
+{
+  public:
+    scope_t(const std::string& name);
+    ~scope_t();
+
+    scope_t(const scope_t&) = delete;
+    scope_t& operator = (const scope_t&) = delete;
+
+  private:
+    /* Index of the stage in the trace, or -1 if not traced */
+    ptrdiff_t index = -1;
+};
+
+/**
+ * Indicate that the given output has submitted a frame. The first call
+ * finishes the trace and writes the results.
+ */
+void first_frame(const std::string& output_name);
+}
+}
+
+#endif /* end of include guard: WF_STARTUP_TRACE_HPP */
@@ -125,19 +125,19 @@ void wayfire_focus::send_done(wayfire_view view)
         return;
 
     /* Do not send done while running */
-    auto surfaces = view->enumerate_surfaces();
-    for (auto& child : surfaces)
+    view->for_each_surface([] (wf::surface_interface_t *surface,
+            const wf_point&)
     {
         auto popup =
-            dynamic_cast<wayfire_xdg_popup<wlr_xdg_popup>*> (child.surface);
+            dynamic_cast<wayfire_xdg_popup<wlr_xdg_popup>*> (surface);
         auto popup_v6 =
-            dynamic_cast<wayfire_xdg_popup<wlr_xdg_popup_v6>*> (child.surface);
+            dynamic_cast<wayfire_xdg_popup<wlr_xdg_popup_v6>*> (surface);
 
         if (popup)
             popup->send_done();
         if (popup_v6)
-            popup->send_done();
-    }
+            popup_v6->send_done();
+    });
 
     set_last_focus(nullptr);
 }
@@ -24,8 +24,11 @@ extern "C"
 #include <wayland-server.h>
 
 #include "core/core-impl.hpp"
+#include "core/startup-trace.hpp"
+#include "core/event-trace.hpp"
 #include "view/view-impl.hpp"
 #include "output.hpp"
+#include "signal-definitions.hpp"
 
 wf_runtime_config runtime_config;
 
@@ -39,15 +42,68 @@ static void reload_config(int fd)
     inotify_add_watch(fd, config_file.c_str(), IN_MODIFY);
 }
 
-static int handle_config_updated(int fd, uint32_t mask, void *data)
+/* Editors often write the config file in several chunks, so wait until the
+ * file has been quiet for a while and then reload it once */
+static const int config_reload_delay_ms = 100;
+static wl_event_source *config_reload_timer;
+
+using config_snapshot_t =
+    std::map<std::string, std::map<std::string, std::string>>;
+
+static config_snapshot_t snapshot_config()
+{
+    config_snapshot_t snapshot;
+    for (auto section : wf::get_core().config->sections)
+    {
+        auto& values = snapshot[section->name];
+        for (auto& opt : section->options)
+            values[opt->name] = opt->as_string();
+    }
+
+    return snapshot;
+}
+
+static int handle_config_reload_timeout(void *data)
 {
     log_info("got a reload");
 
+    auto old_config = snapshot_config();
+    reload_config((int)(intptr_t)data);
+    auto new_config = snapshot_config();
+
+    wf::reload_config_signal ev;
+    for (auto& section : new_config)
+    {
+        auto it = old_config.find(section.first);
+        if (it == old_config.end() || it->second != section.second)
+            ev.changed_sections.insert(section.first);
+    }
+
+    for (auto& section : old_config)
+    {
+        if (!new_config.count(section.first))
+            ev.changed_sections.insert(section.first);
+    }
+
+    if (ev.changed_sections.empty())
+        return 0;
+
+    wf::get_core().emit_signal("reload-config", &ev);
+    return 0;
+}
+
+static int handle_config_updated(int fd, uint32_t mask, void *data)
+{
     /* read, but don't use */
     read(fd, buf, INOT_BUF_SIZE);
-    reload_config(fd);
 
-    wf::get_core().emit_signal("reload-config", nullptr);
+    if (!config_reload_timer)
+    {
+        config_reload_timer = wl_event_loop_add_timer(wf::get_core().ev_loop,
+            handle_config_reload_timeout, (void*)(intptr_t)fd);
+    }
+
+    wl_event_source_timer_update(config_reload_timer, config_reload_delay_ms);
     return 1;
 }
 
@@ -94,6 +150,8 @@ static std::vector<EGLint> generate_config_attribs(EGLint *renderer_attribs)
 wlr_renderer *add_egl_depth_renderer(wlr_egl *egl, EGLenum platform,
                                      void *remote, EGLint *_r_attr, EGLint visual)
 {
+    wf::startup_trace::scope_t trace("EGL and renderer setup");
+
     bool r;
     auto attribs = generate_config_attribs(_r_attr);
     r = wlr_egl_init(egl, platform, remote, attribs.data(), visual);
@@ -150,6 +208,8 @@ static bool drop_permissions(void)
 
 int main(int argc, char *argv[])
 {
+    wf::startup_trace::init();
+
 #ifdef WAYFIRE_DEBUG_ENABLED
     wlr_log_init(WLR_DEBUG, NULL);
 #else
@@ -165,11 +225,12 @@ int main(int argc, char *argv[])
         { "config",          required_argument, NULL, 'c' },
         { "damage-debug",    no_argument,       NULL, 'd' },
         { "damage-rerender", no_argument,       NULL, 'R' },
+        { "frame-stats",     no_argument,       NULL, 's' },
         { 0,                 0,                 NULL,  0  }
     };
 
     int c, i;
-    while((c = getopt_long(argc, argv, "c:dR", opts, &i)) != -1)
+    while((c = getopt_long(argc, argv, "c:dRs", opts, &i)) != -1)
     {
         switch(c)
         {
@@ -182,6 +243,9 @@ int main(int argc, char *argv[])
             case 'R':
                 runtime_config.no_damage_track = true;
                 break;
+            case 's':
+                runtime_config.frame_stats = true;
+                break;
             default:
                 log_error("unrecognized command line argument %s", optarg);
         }
@@ -199,7 +263,14 @@ int main(int argc, char *argv[])
     /** TODO: move this to core_impl constructor */
     core.display  = display;
     core.ev_loop  = wl_display_get_event_loop(core.display);
-    core.backend  = wlr_backend_autocreate(core.display, add_egl_depth_renderer);
+    wf::event_trace::init(core.ev_loop);
+
+    {
+        wf::startup_trace::scope_t trace("backend creation");
+        core.backend = wlr_backend_autocreate(core.display,
+            add_egl_depth_renderer);
+    }
+
     core.renderer = wlr_backend_get_renderer(core.backend);
     core.egl = egl_for_renderer[core.renderer];
     assert(core.egl);
@@ -212,14 +283,19 @@ int main(int argc, char *argv[])
     }
 
     log_info("using config file: %s", config_file.c_str());
-    core.config = new wayfire_config(config_file);
-
     int inotify_fd = inotify_init1(IN_CLOEXEC);
-    reload_config(inotify_fd);
+    {
+        wf::startup_trace::scope_t trace("config loading");
+        core.config = new wayfire_config(config_file);
+        reload_config(inotify_fd);
+    }
 
     wl_event_loop_add_fd(core.ev_loop, inotify_fd, WL_EVENT_READABLE,
         handle_config_updated, NULL);
-    core.init();
+    {
+        wf::startup_trace::scope_t trace("core init");
+        core.init();
+    }
 
     auto server_name = wl_display_add_socket_auto(core.display);
     if (!server_name)
@@ -231,7 +307,15 @@ int main(int argc, char *argv[])
     setenv("_WAYLAND_DISPLAY", server_name, 1);
 
     core.wayland_display = server_name;
-    if (!wlr_backend_start(core.backend))
+
+    /* Starting the backend creates the outputs and loads their plugins */
+    bool backend_started;
+    {
+        wf::startup_trace::scope_t trace("backend start");
+        backend_started = wlr_backend_start(core.backend);
+    }
+
+    if (!backend_started)
     {
         log_error("failed to initialize backend, exiting");
         wlr_backend_destroy(core.backend);
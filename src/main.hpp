@@ -5,6 +5,7 @@ extern struct wf_runtime_config
 {
     bool no_damage_track = false;
     bool damage_debug = false;
+    bool frame_stats = false;
 } runtime_config;
 
 #endif /* end of include guard: MAIN_HPP */
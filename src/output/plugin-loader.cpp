@@ -2,14 +2,17 @@
 #include <algorithm>
 #include <set>
 #include <memory>
+#include <unordered_map>
 #include <dlfcn.h>
 
 #include "plugin-loader.hpp"
 #include "output-layout.hpp"
 #include "output.hpp"
 #include "../core/wm.hpp"
+#include "../core/startup-trace.hpp"
 #include "core.hpp"
 #include "debug.hpp"
+#include "plugin-profiler.hpp"
 
 namespace
 {
@@ -22,6 +25,93 @@ namespace
         helper.x = object;
         return helper.y;
     }
+
+    /**
+     * A plugin library which has been loaded and validated. Each output has
+     * its own plugin instances, but the libraries are shared between outputs,
+     * so that they are opened and checked only once per process.
+     */
+    struct plugin_library_t
+    {
+        void *handle;
+        wayfire_plugin_load_func new_instance;
+        /* Number of plugin instances created from the library */
+        int refcount = 0;
+    };
+
+    std::unordered_map<std::string, plugin_library_t> plugin_libraries;
+
+    plugin_library_t *open_plugin_library(const std::string& path)
+    {
+        auto it = plugin_libraries.find(path);
+        if (it != plugin_libraries.end())
+            return &it->second;
+
+        // RTLD_GLOBAL is required for RTTI/dynamic_cast across plugins
+        void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_GLOBAL);
+        if(handle == NULL)
+        {
+            log_error("error loading plugin: %s", dlerror());
+            return nullptr;
+        }
+
+        /* Check plugin version */
+        auto version_func_ptr = dlsym(handle, "getWayfireVersion");
+        if (version_func_ptr == NULL)
+        {
+            log_error("%s: missing getWayfireVersion()", path.c_str());
+            dlclose(handle);
+            return nullptr;
+        }
+
+        auto version_func =
+            union_cast<void*, wayfire_plugin_version_func> (version_func_ptr);
+        int32_t plugin_abi_version = version_func();
+
+        if (plugin_abi_version != WAYFIRE_API_ABI_VERSION)
+        {
+            log_error("%s: API/ABI version mismatch: Wayfire is %d, plugin built "
+                "with %d", path.c_str(), WAYFIRE_API_ABI_VERSION, plugin_abi_version);
+            dlclose(handle);
+            return nullptr;
+        }
+
+        auto new_instance_func_ptr = dlsym(handle, "newInstance");
+        if(new_instance_func_ptr == NULL)
+        {
+            log_error("%s: missing newInstance(). %s", path.c_str(), dlerror());
+            dlclose(handle);
+            return nullptr;
+        }
+
+        log_debug("loading plugin library %s", path.c_str());
+        auto& library = plugin_libraries[path];
+        library.handle = handle;
+        library.new_instance =
+            union_cast<void*, wayfire_plugin_load_func> (new_instance_func_ptr);
+
+        return &library;
+    }
+
+    /* Drop a reference to the library with the given handle, closing it when
+     * it isn't used by any output anymore */
+    void release_plugin_library(void *handle)
+    {
+        for (auto it = plugin_libraries.begin(); it != plugin_libraries.end(); ++it)
+        {
+            if (it->second.handle != handle)
+                continue;
+
+            if (--it->second.refcount <= 0)
+            {
+                log_debug("unloading plugin library %s", it->first.c_str());
+                dlclose(handle);
+                plugin_libraries.erase(it);
+            }
+
+            return;
+        }
+    }
 }
 
 static const std::string default_plugins = "viewport_impl move resize animate \
@@ -36,8 +126,12 @@ plugin_manager::plugin_manager(wf::output_t *o, wayfire_config *config)
     auto section = config->get_section("core");
     plugins_opt = section->get_option("plugins", "none");
 
-    reload_dynamic_plugins();
-    load_static_plugins();
+    {
+        wf::startup_trace::scope_t trace(
+            std::string("plugins for ") + o->handle->name);
+        reload_dynamic_plugins();
+        load_static_plugins();
+    }
 
     list_updated = [=] ()
     {
@@ -75,6 +169,8 @@ void plugin_manager::init_plugin(wayfire_plugin& p)
     p->grab_interface = std::make_unique<wf::plugin_grab_interface_t> (output);
     p->output = output;
 
+    wf::plugin_profiler::scope_t profile(
+        wf::plugin_profiler::get_handle(p->grab_interface.get()));
     p->init(config);
 }
 
@@ -83,64 +179,37 @@ void plugin_manager::destroy_plugin(wayfire_plugin& p)
     p->grab_interface->ungrab();
     output->deactivate_plugin(p->grab_interface);
 
-    p->fini();
+    {
+        wf::plugin_profiler::scope_t profile(
+            wf::plugin_profiler::get_handle(p->grab_interface.get()));
+        p->fini();
+    }
+
+    /* Hooks and signal connections of the plugin may outlive it */
+    wf::plugin_profiler::plugin_destroyed(p->grab_interface.get());
 
     auto handle = p->handle;
     p.reset();
 
-    /* dlopen()/dlclose() do reference counting, so we should close the plugin
-     * as many times as we opened it.
+    /* Libraries are shared between outputs, so they are closed only after
+     * the last plugin instance from them has been destroyed.
      *
      * We also need to close the handle after deallocating the plugin, otherwise
      * we unload its destructor before calling it. */
     if (handle)
-        dlclose(handle);
+        release_plugin_library(handle);
 }
 
 wayfire_plugin plugin_manager::load_plugin_from_file(std::string path)
 {
-    // RTLD_GLOBAL is required for RTTI/dynamic_cast across plugins
-    void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_GLOBAL);
-    if(handle == NULL)
-    {
-        log_error("error loading plugin: %s", dlerror());
+    auto library = open_plugin_library(path);
+    if (!library)
         return nullptr;
-    }
-
-    /* Check plugin version */
-    auto version_func_ptr = dlsym(handle, "getWayfireVersion");
-    if (version_func_ptr == NULL)
-    {
-        log_error("%s: missing getWayfireVersion()", path.c_str());
-        dlclose(handle);
-        return nullptr;
-    }
-
-    auto version_func =
-        union_cast<void*, wayfire_plugin_version_func> (version_func_ptr);
-    int32_t plugin_abi_version = version_func();
-
-    if (version_func() != WAYFIRE_API_ABI_VERSION)
-    {
-        log_error("%s: API/ABI version mismatch: Wayfire is %d, plugin built "
-            "with %d", path.c_str(), WAYFIRE_API_ABI_VERSION, plugin_abi_version);
-        dlclose(handle);
-        return nullptr;
-    }
-
-    auto new_instance_func_ptr = dlsym(handle, "newInstance");
-    if(new_instance_func_ptr == NULL)
-    {
-        log_error("%s: missing newInstance(). %s", path.c_str(), dlerror());
-        return nullptr;
-    }
 
     log_debug("loading plugin %s", path.c_str());
-    auto new_instance_func =
-        union_cast<void*, wayfire_plugin_load_func> (new_instance_func_ptr);
-
-    auto ptr = wayfire_plugin(new_instance_func());
-    ptr->handle = handle;
+    auto ptr = wayfire_plugin(library->new_instance());
+    ptr->handle = library->handle;
+    ++library->refcount;
     return ptr;
 }
 
@@ -203,6 +272,7 @@ void plugin_manager::reload_dynamic_plugins()
         if (loaded_plugins.count(plugin))
             continue;
 
+        wf::startup_trace::scope_t trace(plugin);
         auto ptr = load_plugin_from_file(plugin);
         if (ptr)
         {
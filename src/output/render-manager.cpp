@@ -6,9 +6,16 @@
 #include "workspace-manager.hpp"
 #include "../core/seat/input-manager.hpp"
 #include "../core/opengl-priv.hpp"
+#include "../core/startup-trace.hpp"
+#include "../core/event-trace.hpp"
+#include "../core/alloc-stats.hpp"
 #include "debug.hpp"
+#include "plugin-profiler.hpp"
+#include "gpu-profiler.hpp"
 #include "../main.hpp"
 #include <algorithm>
+#include <unordered_set>
+#include <unordered_map>
 #include <nonstd/reverse.hpp>
 #include <nonstd/safe-list.hpp>
 
@@ -177,7 +184,11 @@ struct output_damage_t
     wf_region get_ws_damage(wf_point ws)
     {
         auto ws_box = get_ws_box(ws);
-        return (frame_damage & ws_box) + wf_point{-ws_box.x, -ws_box.y};
+
+        wf_region ws_damage;
+        ws_damage.set_translated_intersection(frame_damage, ws_box,
+            {-ws_box.x, -ws_box.y});
+        return ws_damage;
     }
 
     /**
@@ -212,22 +223,40 @@ struct effect_hook_manager_t
 {
     using effect_container_t = wf::safe_list_t<effect_hook_t*>;
     effect_container_t effects[OUTPUT_EFFECT_TOTAL];
+    /* The plugins which added the hooks, used for profiling */
+    std::unordered_map<effect_hook_t*, plugin_profiler::plugin_handle_ptr> owners;
 
     void add_effect(effect_hook_t* hook, output_effect_type_t type)
     {
         effects[type].push_back(hook);
+        owners[hook] = plugin_profiler::get_current_plugin();
     }
 
     void rem_effect(effect_hook_t *hook)
     {
         for (int i = 0; i < OUTPUT_EFFECT_TOTAL; i++)
             effects[i].remove_all(hook);
+
+        owners.erase(hook);
     }
 
     void run_effects(output_effect_type_t type)
     {
-        effects[type].for_each([] (auto effect)
-            { (*effect)(); });
+        static const char *trace_names[OUTPUT_EFFECT_TOTAL] = {
+            "pre effects", "overlay effects", "post-paint effects"};
+        wf::event_trace::scope_t trace(trace_names[type]);
+
+        effects[type].for_each([=] (auto effect)
+        {
+            plugin_profiler::scope_t profile(get_owner(effect));
+            (*effect)();
+        });
+    }
+
+    plugin_profiler::plugin_handle_ptr get_owner(effect_hook_t *hook)
+    {
+        auto it = owners.find(hook);
+        return it == owners.end() ? nullptr : it->second;
     }
 };
 
@@ -238,10 +267,17 @@ struct postprocessing_manager_t
 {
     using post_container_t = wf::safe_list_t<post_hook_t*>;
     post_container_t post_effects;
+    /* Hooks which were added as pixel-local */
+    std::unordered_set<post_hook_t*> pixel_local_effects;
+    /* The plugins which added the hooks, used for profiling */
+    std::unordered_map<post_hook_t*, plugin_profiler::plugin_handle_ptr> owners;
     wf_framebuffer_base post_buffers[3];
     /* Buffer to which other operations render to */
     static constexpr uint32_t default_out_buffer = 0;
 
+    /* The region post hooks have to repaint, in framebuffer coordinates */
+    wf_region post_damage;
+
     output_t *output;
     uint32_t output_width, output_height;
     postprocessing_manager_t(output_t *output)
@@ -249,42 +285,98 @@ struct postprocessing_manager_t
         this->output = output;
     }
 
-    void allocate(int width, int height)
+    /**
+     * Make sure the default buffer has the correct size.
+     *
+     * @return true if the buffer was (re)created, i.e its contents are lost
+     */
+    bool allocate(int width, int height)
     {
         if (post_effects.size() == 0)
-            return;
+            return false;
 
         output_width = width;
         output_height = height;
 
         OpenGL::render_begin();
-        post_buffers[default_out_buffer].allocate(width, height);
+        bool invalidated = post_buffers[default_out_buffer].allocate(width, height);
         OpenGL::render_end();
+
+        return invalidated;
     }
 
-    void add_post(post_hook_t* hook)
+    void add_post(post_hook_t* hook, bool pixel_local)
     {
         post_effects.push_back(hook);
+        owners[hook] = plugin_profiler::get_current_plugin();
+        if (pixel_local)
+            pixel_local_effects.insert(hook);
+
         output->render->damage_whole_idle();
     }
 
     void rem_post(post_hook_t *hook)
     {
         post_effects.remove_all(hook);
+        pixel_local_effects.erase(hook);
+        owners.erase(hook);
         output->render->damage_whole_idle();
     }
 
+    plugin_profiler::plugin_handle_ptr get_owner(post_hook_t *hook)
+    {
+        auto it = owners.find(hook);
+        return it == owners.end() ? nullptr : it->second;
+    }
+
+    /* Whether only the damaged parts of the output need to be postprocessed */
+    bool is_damage_tracked() const
+    {
+        bool all_local = true;
+        post_effects.for_each([&] (auto post) {
+            all_local &= pixel_local_effects.count(post) > 0;
+        });
+
+        return all_local;
+    }
+
+    /* Set post_damage to the given damage, transformed to framebuffer
+     * coordinates */
+    void update_post_damage(const wf_region& damage, int width, int height)
+    {
+        post_damage = damage;
+        wl_output_transform transform =
+            wlr_output_transform_invert(output->handle->transform);
+        wlr_region_transform(post_damage.to_pixman(), post_damage.to_pixman(),
+            transform, width, height);
+    }
+
     /* Run all postprocessing effects, rendering to alternating buffers and
      * finally to the screen.
      *
      * NB: 2 buffers just aren't enough. We render to the zero buffer, and then
      * we alternately render to the second and the third. The reason: We track
-     * damage. So, we need to keep the whole buffer each frame. */
-    void run_post_effects()
+     * damage. So, we need to keep the whole buffer each frame.
+     *
+     * Each hook always renders to the same buffer as long as the list of hooks
+     * doesn't change, so if all hooks are pixel-local, repainting only the
+     * damaged region keeps every buffer up to date. Otherwise, or when a
+     * buffer loses its contents, swap_damage is extended to the whole output. */
+    void run_post_effects(wf_region& swap_damage)
     {
         static wf_framebuffer_base default_framebuffer;
         default_framebuffer.tex = default_framebuffer.fb = 0;
 
+        int width, height;
+        wlr_output_transformed_resolution(output->handle, &width, &height);
+
+        /* A hook which isn't pixel-local can move any damaged pixel anywhere */
+        if (!is_damage_tracked())
+            swap_damage |= wlr_box{0, 0, width, height};
+
+        wf::event_trace::scope_t trace("postprocessing");
+        wf::gpu_profiler::scope_t profile("postprocessing");
+
         int last_buffer_idx = default_out_buffer;
         int next_buffer_idx = 1;
 
@@ -298,10 +390,16 @@ struct postprocessing_manager_t
 
             OpenGL::render_begin();
             /* Make sure we have the correct resolution */
-            next_buffer.allocate(output_width, output_height);
+            if (next_buffer.allocate(output_width, output_height))
+                swap_damage |= wlr_box{0, 0, width, height};
             OpenGL::render_end();
 
-            (*post) (post_buffers[last_buffer_idx], next_buffer);
+            update_post_damage(swap_damage, width, height);
+            {
+                wf::event_trace::scope_t trace("post hook");
+                plugin_profiler::scope_t profile(get_owner(post));
+                (*post) (post_buffers[last_buffer_idx], next_buffer);
+            }
 
             last_buffer_idx = next_buffer_idx;
             next_buffer_idx ^= 0b11; // alternate 1 and 2
@@ -325,6 +423,123 @@ struct postprocessing_manager_t
     }
 };
 
+/**
+ * Collects timing and damage statistics about the frames of an output and
+ * periodically prints a summary. Enabled with --frame-stats, so that the
+ * cost of the repaint pipeline can be measured with real or scripted clients,
+ * e.g on the headless backend.
+ */
+struct frame_stats_t
+{
+    static constexpr int64_t report_interval_ms = 5000;
+
+    output_t *output;
+    int64_t period_start = -1;
+
+    int frames = 0, skipped_frames = 0;
+    int64_t total_paint_us = 0, max_paint_us = 0;
+    int64_t damaged_pixels = 0;
+    uint64_t allocations = 0;
+
+    frame_stats_t(output_t *output)
+    {
+        this->output = output;
+        plugin_profiler::set_enabled(true);
+        gpu_profiler::set_enabled(true);
+    }
+
+    ~frame_stats_t()
+    {
+        plugin_profiler::set_enabled(false);
+        gpu_profiler::set_enabled(false);
+    }
+
+    static int64_t elapsed_us(const timespec& start)
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return (now.tv_sec - start.tv_sec) * 1000000ll +
+            (now.tv_nsec - start.tv_nsec) / 1000ll;
+    }
+
+    /** A frame was requested, but nothing needed to be repainted */
+    void frame_skipped()
+    {
+        ++skipped_frames;
+        maybe_report();
+    }
+
+    /** A frame which started at paint_start, when the allocation counter
+     * was at paint_allocations, has been submitted */
+    void frame_painted(const timespec& paint_start, uint64_t paint_allocations,
+        const wf_region& damage)
+    {
+        auto paint_us = elapsed_us(paint_start);
+        allocations += alloc_stats::get_count() - paint_allocations;
+        ++frames;
+        total_paint_us += paint_us;
+        max_paint_us = std::max(max_paint_us, paint_us);
+
+        for (const auto& box : damage)
+            damaged_pixels += int64_t(box.x2 - box.x1) * (box.y2 - box.y1);
+
+        maybe_report();
+    }
+
+    void maybe_report()
+    {
+        int64_t now = get_current_time();
+        if (period_start < 0)
+            period_start = now;
+
+        if (now - period_start < report_interval_ms)
+            return;
+
+        int64_t output_pixels =
+            int64_t(output->handle->width) * output->handle->height;
+        double avg_paint_ms = frames ? total_paint_us / 1000.0 / frames : 0;
+        double avg_damage = (frames && output_pixels) ?
+            100.0 * damaged_pixels / output_pixels / frames : 0;
+
+        log_info("frame stats for %s: %d frames (%d skipped) in %.1fs, "
+            "paint avg %.2fms max %.2fms, damage avg %.1f%% of the output",
+            output->handle->name, frames, skipped_frames,
+            (now - period_start) / 1000.0, avg_paint_ms,
+            max_paint_us / 1000.0, avg_damage);
+
+        if (alloc_stats::is_available())
+        {
+            log_info("  allocations avg %.1f per frame",
+                frames ? 1.0 * allocations / frames : 0.0);
+        }
+
+        /* The costs are for the frames of all outputs */
+        auto costs = plugin_profiler::get_plugin_costs();
+        for (size_t i = 0; i < costs.size() && i < 3; i++)
+        {
+            log_info("  %s: avg %.2fms max %.2fms per frame, GPU avg %.2fms",
+                costs[i].name.c_str(), costs[i].cpu_avg_ms, costs[i].cpu_max_ms,
+                costs[i].gpu_avg_ms);
+        }
+
+        /* GPU times are -1 if the driver can't measure them */
+        log_info("  GPU avg %.2fms per frame", gpu_profiler::get_frame_gpu_ms());
+        auto passes = gpu_profiler::get_pass_times();
+        for (size_t i = 0; i < passes.size() && i < 3; i++)
+        {
+            log_info("  pass %s: %.1f calls, CPU avg %.2fms, GPU avg %.2fms",
+                passes[i].name.c_str(), passes[i].calls, passes[i].cpu_avg_ms,
+                passes[i].gpu_avg_ms);
+        }
+
+        period_start = now;
+        frames = skipped_frames = 0;
+        total_paint_us = max_paint_us = damaged_pixels = 0;
+        allocations = 0;
+    }
+};
+
 class wf::render_manager::impl
 {
   public:
@@ -334,6 +549,7 @@ class wf::render_manager::impl
     std::unique_ptr<output_damage_t> output_damage;
     std::unique_ptr<effect_hook_manager_t> effects;
     std::unique_ptr<postprocessing_manager_t> postprocessing;
+    std::unique_ptr<frame_stats_t> frame_stats;
 
     wf_option background_color_opt;
     wf_option_callback background_color_opt_changed;
@@ -348,6 +564,8 @@ class wf::render_manager::impl
 
         effects = std::make_unique<effect_hook_manager_t> ();
         postprocessing = std::make_unique<postprocessing_manager_t>(o);
+        if (runtime_config.frame_stats)
+            frame_stats = std::make_unique<frame_stats_t>(o);
 
         on_frame.set_callback([&] (void*) { paint(); });
         on_frame.connect(&output_damage->damage_manager->events.frame);
@@ -401,9 +619,12 @@ class wf::render_manager::impl
     }
 
     render_hook_t renderer;
+    /* The plugin which set the renderer, used for profiling */
+    plugin_profiler::plugin_handle_ptr renderer_owner;
     void set_renderer(render_hook_t rh)
     {
         renderer = rh;
+        renderer_owner = plugin_profiler::get_current_plugin();
         output_damage->damage_whole_idle();
     }
 
@@ -461,8 +682,10 @@ class wf::render_manager::impl
     {
         OpenGL::bind_output(output);
 
-        /* Make sure the default buffer has enough size */
-        postprocessing->allocate(output->handle->width, output->handle->height);
+        /* Make sure the default buffer has enough size. If its contents were
+         * lost, the whole scene has to be rendered again. */
+        if (postprocessing->allocate(output->handle->width, output->handle->height))
+            output_damage->frame_damage |= output_damage->get_damage_box();
     }
 
     /**
@@ -505,6 +728,7 @@ class wf::render_manager::impl
     {
         if (renderer)
         {
+            plugin_profiler::scope_t profile(renderer_owner);
             renderer(get_target_framebuffer());
             /* TODO: let custom renderers specify what they want to repaint... */
             swap_damage |= output_damage->get_damage_box();
@@ -516,14 +740,37 @@ class wf::render_manager::impl
         }
     }
 
+    /**
+     * Render the scenegraph, the overlay effects and the software cursors, and
+     * run postprocessing
+     */
+    void render_scene(wf_region& swap_damage)
+    {
+        /* Part 2: call the renderer, which draws the scenegraph */
+        render_output(swap_damage);
+
+        /* Part 3: finalize the scene: overlay effects and sw cursors */
+        effects->run_effects(OUTPUT_EFFECT_OVERLAY);
+
+        OpenGL::render_begin(get_target_framebuffer());
+        wlr_output_render_software_cursors(output->handle, swap_damage.to_pixman());
+        OpenGL::render_end();
+
+        /* Part 4: postprocessing effects */
+        postprocessing->run_post_effects(swap_damage);
+    }
+
     /**
      * Repaints the whole output, includes all effects and hooks
      */
     void paint()
     {
+        wf::event_trace::scope_t trace("paint");
+
         /* Part 1: frame setup: query damage, etc. */
         timespec repaint_started;
         clock_gettime(CLOCK_MONOTONIC, &repaint_started);
+        uint64_t repaint_allocations = alloc_stats::get_count();
         wf_region swap_damage;
 
         effects->run_effects(OUTPUT_EFFECT_PRE);
@@ -532,42 +779,56 @@ class wf::render_manager::impl
         if (!output_damage->make_current(needs_swap))
             return;
 
+        /* wlroots tracks only damage inside the output, but custom renderers
+         * like expo also show the workspace streams of other workspaces */
+        if (renderer && !output_damage->frame_damage.empty())
+            needs_swap = true;
+
         if (!needs_swap && !constant_redraw_counter)
         {
             /* Optimization: the output doesn't need a swap (so isn't damaged),
              * and no plugin wants custom redrawing - we can just skip the whole
              * repaint */
+            if (frame_stats)
+                frame_stats->frame_skipped();
+
             post_paint();
             return;
         }
 
         bind_output();
+        gpu_profiler::begin_frame();
 
-        /* Part 2: call the renderer, which draws the scenegraph */
-        render_output(swap_damage);
-
-        /* Part 3: finalize the scene: overlay effects and sw cursors */
-        effects->run_effects(OUTPUT_EFFECT_OVERLAY);
+        /* The output shows only black while inhibited, so the scene would be
+         * thrown away anyway. It is still rendered if plugins hook into the
+         * rendering, because they may drive their state from the hooks, for
+         * ex. custom renderers which deactivate themselves when done. */
+        bool has_render_hooks = renderer ||
+            effects->effects[OUTPUT_EFFECT_OVERLAY].size() ||
+            postprocessing->post_effects.size();
 
-        if (postprocessing->post_effects.size())
-            swap_damage |= output_damage->get_damage_box();
-
-        OpenGL::render_begin(get_target_framebuffer());
-        wlr_output_render_software_cursors(output->handle, swap_damage.to_pixman());
-        OpenGL::render_end();
+        if (!output_inhibit_counter || has_render_hooks)
+            render_scene(swap_damage);
 
-        /* Part 4: postprocessing effects */
-        postprocessing->run_post_effects();
         if (output_inhibit_counter)
         {
             OpenGL::render_begin(output->handle->width, output->handle->height, 0);
             OpenGL::clear({0, 0, 0, 1});
             OpenGL::render_end();
+            swap_damage |= output_damage->get_damage_box();
         }
 
         /* Part 5: finalize frame: swap buffers, send frame_done, etc */
+        gpu_profiler::end_frame();
         OpenGL::unbind_output(output);
         output_damage->swap_buffers(swap_damage);
+        if (frame_stats)
+            frame_stats->frame_painted(repaint_started, repaint_allocations,
+                swap_damage);
+        plugin_profiler::frame_done();
+        if (wf::startup_trace::is_enabled())
+            wf::startup_trace::first_frame(output->handle->name);
+
         post_paint();
     }
 
@@ -608,8 +869,11 @@ class wf::render_manager::impl
             if (!view->is_mapped())
                 continue;
 
-            for (auto& child : view->enumerate_surfaces())
-                child.surface->send_frame_done(repaint_ended);
+            view->for_each_surface([&repaint_ended] (
+                    wf::surface_interface_t *surface, const wf_point&)
+            {
+                surface->send_frame_done(repaint_ended);
+            });
         }
     }
 
@@ -733,8 +997,11 @@ class wf::render_manager::impl
         offset.x -= og.x;
         offset.y -= og.y;
 
-        for (auto& child : drag_icon->enumerate_surfaces(offset))
-            schedule_surface(repaint, child.surface, child.position);
+        drag_icon->for_each_surface([&] (wf::surface_interface_t *surface,
+                const wf_point& position)
+        {
+            schedule_surface(repaint, surface, position);
+        }, offset);
     }
 
     /**
@@ -792,8 +1059,11 @@ class wf::render_manager::impl
                 obox.x -= view_delta.x;
                 obox.y -= view_delta.y;
 
-                for (auto& child : view->enumerate_surfaces({obox.x, obox.y}))
-                    schedule_surface(repaint, child.surface, child.position);
+                view->for_each_surface([&] (wf::surface_interface_t *surface,
+                        const wf_point& position)
+                {
+                    schedule_surface(repaint, surface, position);
+                }, {obox.x, obox.y});
             }
 
             ++it;
@@ -887,6 +1157,7 @@ class wf::render_manager::impl
         if (repaint.ws_damage.empty())
             return;
 
+        wf::gpu_profiler::scope_t profile("workspace stream");
         {
             stream_signal_t data(repaint.ws_damage, repaint.fb);
             output->render->emit_signal("workspace-stream-pre", &data);
@@ -925,8 +1196,9 @@ void render_manager::schedule_redraw() { pimpl->output_damage->schedule_repaint(
 void render_manager::add_inhibit(bool add) { pimpl->add_inhibit(add); }
 void render_manager::add_effect(effect_hook_t* hook, output_effect_type_t type) {pimpl->effects->add_effect(hook, type); }
 void render_manager::rem_effect(effect_hook_t* hook) { pimpl->effects->rem_effect(hook); }
-void render_manager::add_post(post_hook_t* hook) { pimpl->postprocessing->add_post(hook); }
+void render_manager::add_post(post_hook_t* hook, bool pixel_local) { pimpl->postprocessing->add_post(hook, pixel_local); }
 void render_manager::rem_post(post_hook_t* hook) { pimpl->postprocessing->rem_post(hook); }
+const wf_region& render_manager::get_post_damage() const { return pimpl->postprocessing->post_damage; }
 wf_region render_manager::get_scheduled_damage() { return pimpl->output_damage->get_scheduled_damage(); }
 void render_manager::damage_whole() { pimpl->output_damage->damage_whole(); }
 void render_manager::damage_whole_idle() { pimpl->output_damage->damage_whole_idle(); }
@@ -1,6 +1,7 @@
 #include "util.hpp"
 #include <debug.hpp>
 #include <core.hpp>
+#include "core/event-trace.hpp"
 #include <ctime>
 #include <cmath>
 
@@ -321,6 +322,14 @@ wf_region& wf_region::operator ^= (const wf_region& other)
     return *this;
 }
 
+void wf_region::set_translated_intersection(const wf_region& other,
+    const wlr_box& box, const wf_point& delta)
+{
+    pixman_region32_intersect_rect(this->to_pixman(), other.unconst(),
+        box.x, box.y, box.width, box.height);
+    pixman_region32_translate(this->to_pixman(), delta.x, delta.y);
+}
+
 pixman_region32_t *wf_region::to_pixman()
 {
     return &_region;
@@ -380,12 +389,14 @@ static void handle_wrapped_listener(wl_listener *listener, void *data)
 static void handle_idle_listener(void *data)
 {
     auto call = (wf::wl_idle_call*)(data);
+    wf::event_trace::scope_t trace("idle call");
     call->execute();
 }
 
 static int handle_timeout(void *data)
 {
     auto timer = (wf::wl_timer*) (data);
+    wf::event_trace::scope_t trace("timer");
     timer->execute();
     return 0;
 }
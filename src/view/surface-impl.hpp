@@ -30,6 +30,21 @@ class surface_interface_t::impl
      * subtract_opaque(), send_frame_done(), etc. work for the surface
      */
     wlr_surface *wsurface = nullptr;
+
+    /**
+     * The opaque region of wsurface as subtracted by subtract_opaque(), i.e
+     * translated, scaled to the output and shrunk. It is recomputed only after
+     * a commit or when the parameters change.
+     */
+    struct
+    {
+        bool dirty = true;
+        wf_region region;
+
+        wf_point position;
+        float scale;
+        int shrink;
+    } cached_opaque;
 };
 
 /**
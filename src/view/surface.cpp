@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <map>
 extern "C"
 {
@@ -13,9 +14,11 @@ extern "C"
 }
 
 #include "surface-impl.hpp"
+#include "view-impl.hpp"
 #include "subsurface.hpp"
 #include "opengl.hpp"
 #include "../core/core-impl.hpp"
+#include "../core/event-trace.hpp"
 #include "output.hpp"
 #include "debug.hpp"
 #include "render-manager.hpp"
@@ -35,6 +38,7 @@ wf::surface_interface_t::surface_interface_t(surface_interface_t *parent)
         set_output(parent->get_output());
         parent->priv->surface_children.insert(
             parent->priv->surface_children.begin(), this);
+        invalidate_view_bounding_box(parent);
     }
 }
 
@@ -45,6 +49,7 @@ wf::surface_interface_t::~surface_interface_t()
         auto& container = priv->parent_surface->priv->surface_children;
         auto it = std::remove(container.begin(), container.end(), this);
         container.erase(it, container.end());
+        invalidate_view_bounding_box(priv->parent_surface);
     }
 
     for (auto c : priv->surface_children)
@@ -75,22 +80,45 @@ std::vector<wf::surface_iterator_t> wf::surface_interface_t::enumerate_surfaces(
     wf_point surface_origin)
 {
     std::vector<wf::surface_iterator_t> result;
-    for (auto& child : priv->surface_children)
+    for_each_surface([&result] (surface_interface_t *surface,
+            const wf_point& position)
+    {
+        result.push_back({surface, position});
+    }, surface_origin);
+
+    return result;
+}
+
+void wf::surface_interface_t::visit_surfaces(surface_visitor_t visitor,
+    void *data, wf_point surface_origin, bool bottom_first)
+{
+    if (bottom_first && is_mapped())
+        visitor(data, this, surface_origin);
+
+    auto visit_child = [&] (surface_interface_t *child)
     {
         if (child->is_mapped())
         {
-            auto child_surfaces = child->enumerate_surfaces(
-                child->get_offset() + surface_origin);
+            child->visit_surfaces(visitor, data,
+                child->get_offset() + surface_origin, bottom_first);
+        }
+    };
 
-            result.insert(result.end(),
-                child_surfaces.begin(), child_surfaces.end());
+    if (bottom_first)
+    {
+        for (auto it = priv->surface_children.rbegin();
+             it != priv->surface_children.rend(); ++it)
+        {
+            visit_child(*it);
         }
+    } else
+    {
+        for (auto& child : priv->surface_children)
+            visit_child(child);
     }
 
-    if (is_mapped())
-        result.push_back({this, surface_origin});
-
-    return result;
+    if (!bottom_first && is_mapped())
+        visitor(data, this, surface_origin);
 }
 
 wf::output_t *wf::surface_interface_t::get_output()
@@ -156,21 +184,47 @@ void wf::surface_interface_t::subtract_opaque(wf_region& region, int x, int y)
     if (!priv->wsurface)
         return;
 
-    wf_region opaque{&priv->wsurface->opaque_region};
-    opaque += wf_point{x, y};
-    opaque *= get_output()->handle->scale;
-
     /* region scaling uses std::ceil/std::floor, so the resulting region
      * encompasses the opaque region. However, in the case of opaque region, we
      * don't want any pixels that aren't actually opaque. So in case of
      * different scales, we just shrink by 1 to compensate for the ceil/floor
      * discrepancy */
     int ceil_factor = 0;
-    if (get_output()->handle->scale != (float)priv->wsurface->current.scale)
+    float scale = get_output()->handle->scale;
+    if (scale != (float)priv->wsurface->current.scale)
         ceil_factor = 1;
 
-    opaque.expand_edges(-get_active_shrink_constraint() - ceil_factor);
-    region ^= opaque;
+    int shrink = get_active_shrink_constraint() + ceil_factor;
+    wf_point position = {x, y};
+
+    auto& cache = priv->cached_opaque;
+    bool same_params = !cache.dirty &&
+        cache.scale == scale && cache.shrink == shrink;
+
+    /* With integer scales, moving the surface just moves the scaled region */
+    if (same_params && cache.position != position &&
+        scale == std::floor(scale))
+    {
+        cache.region += wf_point{
+            int((position.x - cache.position.x) * scale),
+            int((position.y - cache.position.y) * scale)};
+        cache.position = position;
+    }
+
+    if (!same_params || cache.position != position)
+    {
+        cache.region = wf_region{&priv->wsurface->opaque_region};
+        cache.region += position;
+        cache.region *= scale;
+        cache.region.expand_edges(-shrink);
+
+        cache.dirty = false;
+        cache.position = position;
+        cache.scale = scale;
+        cache.shrink = shrink;
+    }
+
+    region ^= cache.region;
 }
 
 wl_client* wf::surface_interface_t::get_client()
@@ -204,7 +258,10 @@ wf::wlr_surface_base_t::wlr_surface_base_t(surface_interface_t *self)
     };
 
     on_new_subsurface.set_callback(handle_new_subsurface);
-    on_commit.set_callback([&] (void*) { commit(); });
+    on_commit.set_callback([&] (void*) {
+        wf::event_trace::scope_t trace("surface commit");
+        commit();
+    });
 }
 
 wf::wlr_surface_base_t::~wlr_surface_base_t() {}
@@ -235,6 +292,7 @@ wf_size_t wf::wlr_surface_base_t::_get_size() const
 void wf::emit_map_state_change(wf::surface_interface_t *surface)
 {
     std::string state = surface->is_mapped() ? "_surface_mapped" : "_surface_unmapped";
+    invalidate_view_bounding_box(surface);
 
     _surface_map_state_changed_signal data;
     data.surface = surface;
@@ -247,6 +305,7 @@ void wf::wlr_surface_base_t::map(wlr_surface *surface)
     this->surface = surface;
 
     _as_si->priv->wsurface = surface;
+    _as_si->priv->cached_opaque.dirty = true;
 
     /* force surface_send_enter(), and also check whether parent surface
      * output hasn't changed while we were unmapped */
@@ -331,6 +390,10 @@ void wf::wlr_surface_base_t::apply_surface_damage()
 
 void wf::wlr_surface_base_t::commit()
 {
+    /* The opaque region and the size might have changed */
+    _as_si->priv->cached_opaque.dirty = true;
+    invalidate_view_bounding_box(_as_si);
+
     apply_surface_damage();
     if (_as_si->get_output())
     {
@@ -198,6 +198,7 @@ void wf::wlr_view_t::update_size()
 
     if (view_impl->frame)
         view_impl->frame->notify_view_resized(get_wm_geometry());
+    invalidate_view_bounding_box(this);
 }
 
 wf_geometry wf::wlr_view_t::get_output_geometry()
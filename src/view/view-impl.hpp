@@ -64,8 +64,28 @@ class view_interface_t::view_priv_impl
         wf_region cached_damage;
         bool valid() { return this->fb != (uint32_t)-1; }
     } offscreen_buffer;
+
+    /**
+     * The untransformed bounding box of the mapped surface tree, relative to
+     * the output geometry. See invalidate_view_bounding_box() for when it is
+     * recalculated.
+     */
+    struct
+    {
+        bool valid = false;
+        wf_size_t output_size;
+        wf_geometry box;
+    } cached_bounding_box;
 };
 
+/**
+ * Invalidate the cached bounding box of the view the surface belongs to.
+ * Called whenever the size or position of a surface in the tree might change:
+ * on commit, map, unmap, when surfaces are added or removed, when the
+ * decoration changes, and on view damage().
+ */
+void invalidate_view_bounding_box(surface_interface_t *surface);
+
 /**
  * Implementation of a view backed by a wlr_* shell struct.
  */
@@ -8,6 +8,7 @@
 #include "decorator.hpp"
 #include "workspace-manager.hpp"
 #include "render-manager.hpp"
+#include "gpu-profiler.hpp"
 #include "xdg-shell.hpp"
 #include "../output/gtk-shell.hpp"
 
@@ -226,19 +227,28 @@ wf::surface_interface_t *wf::view_interface_t::map_input_coordinates(
     auto view_relative_coordinates =
         global_to_local_point(cursor, nullptr);
 
-    for (auto& child : enumerate_surfaces({0, 0}))
+    /* The topmost surface which accepts input wins */
+    wf::surface_interface_t *target = nullptr;
+    for_each_surface([&] (wf::surface_interface_t *surface,
+            const wf_point& position)
     {
-        local.x = view_relative_coordinates.x - child.position.x;
-        local.y = view_relative_coordinates.y - child.position.y;
+        if (target)
+            return;
+
+        wf_pointf surface_local = {
+            view_relative_coordinates.x - position.x,
+            view_relative_coordinates.y - position.y,
+        };
 
-        if (child.surface->accepts_input(
-                std::floor(local.x), std::floor(local.y)))
+        if (surface->accepts_input(
+                std::floor(surface_local.x), std::floor(surface_local.y)))
         {
-            return child.surface;
+            target = surface;
+            local = surface_local;
         }
-    }
+    });
 
-    return nullptr;
+    return target;
 }
 
 bool wf::view_interface_t::is_focuseable() const
@@ -284,6 +294,7 @@ void wf::view_interface_t::set_tiled(uint32_t edges)
     this->tiled_edges = edges;
     if (view_impl->frame)
         view_impl->frame->notify_view_tiled();
+    invalidate_view_bounding_box(this);
 
     this->emit_signal("tiled", nullptr);
     desktop_state_updated();
@@ -305,6 +316,7 @@ void wf::view_interface_t::set_fullscreen(bool full)
     fullscreen = full;
     if (view_impl->frame)
         view_impl->frame->notify_view_fullscreen();
+    invalidate_view_bounding_box(this);
 
     if (fullscreen && get_output())
     {
@@ -472,6 +484,9 @@ bool wf::view_interface_t::is_visible()
 
 void wf::view_interface_t::damage()
 {
+    /* Plugins and surfaces damage views after changing them in ways we aren't
+     * notified about otherwise */
+    invalidate_view_bounding_box(this);
     damage_box(get_untransformed_bounding_box());
 }
 
@@ -546,6 +561,7 @@ void wf::view_interface_t::set_decoration(surface_interface_t *frame)
 
     // notify the frame of the current size
     view_impl->frame->notify_view_resized(get_wm_geometry());
+    invalidate_view_bounding_box(this);
     // but request the target size, it will be sent to the frame on the
     // next commit
     set_geometry(target_wm_geometry);
@@ -622,17 +638,38 @@ wf_geometry wf::view_interface_t::get_untransformed_bounding_box()
     if (!is_mapped())
         return view_impl->offscreen_buffer.geometry;
 
-    auto bbox = get_output_geometry();
-    wf_region bounding_region = bbox;
-
-    for (auto& child : enumerate_surfaces({bbox.x, bbox.y}))
+    auto og = get_output_geometry();
+    auto& cache = view_impl->cached_bounding_box;
+    if (!cache.valid || cache.output_size.width != og.width ||
+        cache.output_size.height != og.height)
     {
-        auto dim = child.surface->get_size();
-        bounding_region |= {child.position.x, child.position.y,
-            dim.width, dim.height};
-    };
+        wf_region bounding_region = wlr_box{0, 0, og.width, og.height};
+        for_each_surface([&bounding_region] (wf::surface_interface_t *surface,
+                const wf_point& position)
+        {
+            auto dim = surface->get_size();
+            bounding_region |= {position.x, position.y, dim.width, dim.height};
+        }, {0, 0});
+
+        cache.box = wlr_box_from_pixman_box(bounding_region.get_extents());
+        cache.output_size = {og.width, og.height};
+        cache.valid = true;
+    }
 
-    return wlr_box_from_pixman_box(bounding_region.get_extents());
+    auto bbox = cache.box;
+    bbox.x += og.x;
+    bbox.y += og.y;
+
+    return bbox;
+}
+
+void wf::invalidate_view_bounding_box(wf::surface_interface_t *surface)
+{
+    auto view =
+        dynamic_cast<wf::view_interface_t*> (surface->get_main_surface());
+
+    if (view && view->view_impl)
+        view->view_impl->cached_bounding_box.valid = false;
 }
 
 wlr_box wf::view_interface_t::get_bounding_box(std::string transformer)
@@ -700,18 +737,22 @@ bool wf::view_interface_t::intersects_region(const wlr_box& region)
     if (!is_mapped())
         return region & get_bounding_box();
 
+    bool intersects = false;
     auto origin = get_output_geometry();
-    for (auto& child : enumerate_surfaces({origin.x, origin.y}))
+    for_each_surface([&] (wf::surface_interface_t *surface,
+            const wf_point& position)
     {
-        wlr_box box = {child.position.x, child.position.y,
-            child.surface->get_size().width, child.surface->get_size().height};
+        if (intersects)
+            return;
+
+        wlr_box box = {position.x, position.y,
+            surface->get_size().width, surface->get_size().height};
         box = transform_region(box);
 
-        if (region & box)
-            return true;
-    }
+        intersects = (region & box);
+    }, {origin.x, origin.y});
 
-    return false;
+    return intersects;
 }
 
 bool wf::view_interface_t::render_transformed(const wf_framebuffer& framebuffer,
@@ -720,6 +761,7 @@ bool wf::view_interface_t::render_transformed(const wf_framebuffer& framebuffer,
     if (!is_mapped() && !view_impl->offscreen_buffer.valid())
         return false;
 
+    wf::gpu_profiler::scope_t profile("view render");
     take_snapshot();
     auto& offscreen_buffer = view_impl->offscreen_buffer;
     auto& transforms = view_impl->transforms;
@@ -854,12 +896,12 @@ void wf::view_interface_t::take_snapshot()
     int ox = output_geometry.x - buffer_geometry.x;
     int oy = output_geometry.y - buffer_geometry.y;
 
-    auto children = enumerate_surfaces({ox, oy});
-    for (auto& child : wf::reverse(children))
+    for_each_surface_reverse([&] (wf::surface_interface_t *surface,
+            const wf_point& position)
     {
-        child.surface->simple_render(offscreen_buffer,
-            child.position.x, child.position.y, full_region);
-    }
+        surface->simple_render(offscreen_buffer,
+            position.x, position.y, full_region);
+    }, {ox, oy});
 }
 
 wf::view_interface_t::view_interface_t() : surface_interface_t(nullptr)
@@ -6,6 +6,7 @@
 #include "output-layout.hpp"
 #include "../core/core-impl.hpp"
 #include "view-impl.hpp"
+#include "../core/startup-trace.hpp"
 
 extern "C"
 {
@@ -521,6 +522,7 @@ static wlr_xwayland *xwayland_handle = nullptr;
 void wf::init_xwayland()
 {
 #if WLR_HAS_XWAYLAND
+    wf::startup_trace::scope_t trace("XWayland launch");
     static wf::wl_listener_wrapper on_created;
     static signal_callback_t on_shutdown = [&] (void*) {
         wlr_xwayland_destroy(xwayland_handle);